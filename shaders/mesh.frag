@@ -0,0 +1,62 @@
+#version 450
+
+#define UINT_MAX 4294967295u
+
+// variants, see ShaderVariants: UNTEXTURED skips the texture lookup and NO_CROSSHAIR the crosshair
+
+in vec3 vLocalPosition;
+in vec3 vPosition;
+flat in vec3 vNormal;
+flat in vec3 vColor;
+flat in uint vTextureIndex;
+
+uniform sampler2DArray uTextures;
+
+uniform vec2 uViewportSize;
+
+uniform float uReach;
+
+out vec4 outColor;
+
+void main(void) {
+    vec3 light = normalize(vec3(0.3, 1.0, -0.5));
+
+    // the texture repeats once per voxel across the merged quad, with the same face orientation as
+    // the billboards
+    vec3 f = fract(vLocalPosition);
+    vec2 textureCoord;
+    if (vNormal.x > 0)
+        textureCoord = vec2(1.0 - f.z, f.y);
+    else if (vNormal.x < 0)
+        textureCoord = f.zy;
+    else if (vNormal.y > 0)
+        textureCoord = vec2(1.0 - f.x, f.z);
+    else if (vNormal.y < 0)
+        textureCoord = f.xz;
+    else if (vNormal.z > 0)
+        textureCoord = f.xy;
+    else
+        textureCoord = vec2(1.0 - f.x, f.y);
+
+    vec3 lightColor = vec3(1.0, 1.0, 1.0);
+    vec3 ambient = vec3(0.1, 0.1, 0.1);
+    vec3 diffuse = lightColor * max(dot(vNormal, light), 0.0);
+    outColor = vec4(vColor * (ambient + diffuse), 1.0);
+
+#ifndef UNTEXTURED
+    if (vTextureIndex != UINT_MAX)
+        outColor *= texture(uTextures, vec3(textureCoord, vTextureIndex));
+#endif
+
+#ifndef NO_CROSSHAIR
+    // draw a circular crosshair mid-screen
+    vec2 aspect = vec2(uViewportSize.x / uViewportSize.y, 1.0);
+    if (length((gl_FragCoord.xy / uViewportSize * aspect) - (aspect * 0.5)) < 0.005) {
+        if (length(vPosition) < uReach) {
+            outColor = mix(vec4(0.0, 1.0, 0.2, 1.0), outColor, 0.5);
+        } else {
+            outColor = mix(vec4(1.0, 0.0, 0.2, 1.0), outColor, 0.5);
+        }
+    }
+#endif
+}
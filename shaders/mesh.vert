@@ -0,0 +1,48 @@
+#version 450
+
+#define MAX_MATERIALS 1024u
+
+// chunk local corner x, y, z 7 bits each, then the face direction 3 bits
+layout(location = 0) in uint aPackedPosition;
+layout(location = 1) in uint aMaterialIndex;
+
+struct Material {
+    vec4 color;
+    uint texture;
+};
+
+layout(binding = 0) uniform uMaterials {
+    Material materials[MAX_MATERIALS];
+};
+
+uniform mat4 uProjectionView;
+uniform vec3 uCameraPosition;
+uniform vec3 uChunkPosition;
+uniform float uChunkSize;
+
+// +x, -x, +y, -y, +z, -z like NEIGHBOR_OFFSETS
+const vec3 NORMALS[6] = vec3[](
+    vec3(1.0, 0.0, 0.0), vec3(-1.0, 0.0, 0.0),
+    vec3(0.0, 1.0, 0.0), vec3(0.0, -1.0, 0.0),
+    vec3(0.0, 0.0, 1.0), vec3(0.0, 0.0, -1.0)
+);
+
+out vec3 vLocalPosition;
+out vec3 vPosition;
+flat out vec3 vNormal;
+flat out vec3 vColor;
+flat out uint vTextureIndex;
+
+void main(void) {
+    vec3 position = vec3(float((aPackedPosition >> 14) & 0x7Fu),
+                         float((aPackedPosition >> 7) & 0x7Fu),
+                         float(aPackedPosition & 0x7Fu));
+    vec3 relativePosition = position + uChunkPosition * uChunkSize - uCameraPosition;
+    gl_Position = uProjectionView * vec4(relativePosition, 1.0);
+
+    vLocalPosition = position;
+    vPosition = relativePosition;
+    vNormal = NORMALS[(aPackedPosition >> 21) & 0x7u];
+    vColor = materials[aMaterialIndex].color.xyz;
+    vTextureIndex = materials[aMaterialIndex].texture;
+}
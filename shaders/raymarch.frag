@@ -0,0 +1,175 @@
+#version 450
+
+#define UINT_MAX 4294967295u
+
+// variants, see ShaderVariants: UNTEXTURED skips the texture lookup and NO_CROSSHAIR the crosshair
+#define MAX_MATERIALS 1024u
+#define CHUNK_SIZE 64
+#define CHUNK_SHIFT 6
+#define LOD_LEVELS 4
+#define EMPTY_CELL 0xFFFFu
+#define MAX_STEPS 1024
+
+struct Material {
+    vec4 color;
+    uint texture;
+};
+
+layout(binding = 0) uniform uMaterials {
+    Material materials[MAX_MATERIALS];
+};
+
+// 16 bit material ids of all levels of every chunk, two per word, uGridWords words per chunk
+layout(std430, binding = 1) readonly buffer uGrids {
+    uint grids[];
+};
+
+// grid slot of every chunk position in [uVolumeMin, uVolumeMin + uVolumeSize), -1 where there is none
+layout(std430, binding = 2) readonly buffer uChunkMap {
+    int chunkMap[];
+};
+
+uniform ivec3 uVolumeMin;
+uniform ivec3 uVolumeSize;
+uniform int uGridWords;
+
+uniform sampler2DArray uTextures;
+
+uniform mat4 uProjectionView;
+uniform mat4 uInvProjectionView;
+uniform vec3 uCameraPosition;
+
+uniform vec2 uViewportSize;
+
+uniform float uReach;
+
+out vec4 outColor;
+
+int levelOffset(int level) {
+    int offset = 0;
+    for (int l = 0; l < level; ++l) {
+        int size = CHUNK_SIZE >> l;
+        offset += size * size * size;
+    }
+    return offset;
+}
+
+uint readCell(int slot, int level, ivec3 cell) {
+    int size = CHUNK_SIZE >> level;
+    uint index = uint(slot) * uint(uGridWords) * 2u + uint(levelOffset(level) + (cell.x * size + cell.y) * size + cell.z);
+    return (grids[index >> 1u] >> ((index & 1u) * 16u)) & 0xFFFFu;
+}
+
+float minComponent(vec3 a) {
+    return min(a.x, min(a.y, a.z));
+}
+
+float maxComponent(vec3 a) {
+    return max(a.x, max(a.y, a.z));
+}
+
+void main(void) {
+    vec3 light = normalize(vec3(0.3, 1.0, -0.5));
+
+    vec2 screenPosition = gl_FragCoord.xy / uViewportSize * 2.0 - 1.0;
+    vec3 direction = normalize(vec3(uInvProjectionView * vec4(screenPosition, -1.0, 1.0)));
+    // keeps the reciprocals finite along the axes
+    direction = mix(direction, vec3(1e-7), equal(direction, vec3(0.0)));
+    vec3 invDirection = 1.0 / direction;
+    vec3 origin = uCameraPosition;
+
+    ivec3 volumeMin = uVolumeMin * CHUNK_SIZE;
+    ivec3 volumeMax = (uVolumeMin + uVolumeSize) * CHUNK_SIZE;
+    vec3 tNear = (vec3(volumeMin) - origin) * invDirection;
+    vec3 tFar = (vec3(volumeMax) - origin) * invDirection;
+    vec3 tEnter = min(tNear, tFar);
+    float t = max(maxComponent(tEnter), 0.0);
+    if (t >= minComponent(max(tNear, tFar)))
+        discard;
+
+    // axis of the last face the ray crossed
+    int axis = tEnter.x == maxComponent(tEnter) ? 0 : (tEnter.y == maxComponent(tEnter) ? 1 : 2);
+    ivec3 voxel = clamp(ivec3(floor(origin + direction * t)), volumeMin, volumeMax - 1);
+    uint material = EMPTY_CELL;
+    for (int i = 0; i < MAX_STEPS; ++i) {
+        if (any(lessThan(voxel, volumeMin)) || any(greaterThanEqual(voxel, volumeMax)))
+            break;
+
+        // find the largest empty cell around the voxel, a whole chunk if it is missing and else the
+        // coarsest empty level, which are only empty if every voxel below them is
+        ivec3 chunk = (voxel >> CHUNK_SHIFT) - uVolumeMin;
+        int slot = chunkMap[(chunk.x * uVolumeSize.y + chunk.y) * uVolumeSize.z + chunk.z];
+        int size = CHUNK_SIZE;
+        if (slot >= 0) {
+            ivec3 local = voxel & (CHUNK_SIZE - 1);
+            for (int level = LOD_LEVELS - 1; level >= 0; --level) {
+                material = readCell(slot, level, local >> level);
+                if (material == EMPTY_CELL) {
+                    size = 1 << level;
+                    break;
+                }
+            }
+            if (material != EMPTY_CELL)
+                break;
+        }
+
+        // step to the cell the ray enters when it leaves this one
+        vec3 cellMin = vec3(voxel & ~(size - 1));
+        vec3 cellMax = cellMin + float(size);
+        vec3 tExit = (mix(cellMin, cellMax, greaterThan(direction, vec3(0.0))) - origin) * invDirection;
+        t = minComponent(tExit);
+        axis = tExit.x == t ? 0 : (tExit.y == t ? 1 : 2);
+        ivec3 next = clamp(ivec3(floor(origin + direction * t)), ivec3(cellMin), ivec3(cellMax) - 1);
+        next[axis] = direction[axis] > 0.0 ? int(cellMax[axis]) : int(cellMin[axis]) - 1;
+        voxel = next;
+    }
+    if (material == EMPTY_CELL)
+        discard;
+
+    vec3 hit = direction * t;
+    vec4 clip = uProjectionView * vec4(hit, 1.0);
+    gl_FragDepth = clip.z / clip.w * 0.5 + 0.5;
+
+    vec3 normal = vec3(0.0);
+    normal[axis] = -sign(direction[axis]);
+
+    // same face orientation as the billboards
+    vec3 f = clamp(origin + hit - vec3(voxel), 0.0, 1.0);
+    vec2 textureCoord;
+    if (normal.x > 0)
+        textureCoord = vec2(1.0 - f.z, f.y);
+    else if (normal.x < 0)
+        textureCoord = f.zy;
+    else if (normal.y > 0)
+        textureCoord = vec2(1.0 - f.x, f.z);
+    else if (normal.y < 0)
+        textureCoord = f.xz;
+    else if (normal.z > 0)
+        textureCoord = f.xy;
+    else
+        textureCoord = vec2(1.0 - f.x, f.y);
+
+    vec3 color = materials[material].color.xyz;
+    vec3 lightColor = vec3(1.0, 1.0, 1.0);
+    vec3 ambient = vec3(0.1, 0.1, 0.1);
+    vec3 diffuse = lightColor * max(dot(normal, light), 0.0);
+    outColor = vec4(color * (ambient + diffuse), 1.0);
+
+#ifndef UNTEXTURED
+    uint textureIndex = materials[material].texture;
+    if (textureIndex != UINT_MAX)
+        outColor *= texture(uTextures, vec3(textureCoord, textureIndex));
+#endif
+
+#ifndef NO_CROSSHAIR
+    // draw a circular crosshair mid-screen
+    vec2 aspect = vec2(uViewportSize.x / uViewportSize.y, 1.0);
+    if (length((gl_FragCoord.xy / uViewportSize * aspect) - (aspect * 0.5)) < 0.005) {
+        if (t < uReach) {
+            outColor = mix(vec4(0.0, 1.0, 0.2, 1.0), outColor, 0.5);
+        } else {
+            outColor = mix(vec4(1.0, 0.0, 0.2, 1.0), outColor, 0.5);
+        }
+    }
+#endif
+}
@@ -0,0 +1,7 @@
+#version 450
+
+// a single triangle covering the whole screen, drawn without any vertex buffer
+void main(void) {
+    vec2 position = vec2(gl_VertexID & 1, gl_VertexID >> 1) * 4.0 - 1.0;
+    gl_Position = vec4(position, 0.0, 1.0);
+}
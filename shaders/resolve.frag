@@ -0,0 +1,118 @@
+#version 450
+
+#define UINT_MAX 4294967295u
+
+// variants, see ShaderVariants: UNTEXTURED skips the texture lookup and NO_CROSSHAIR the crosshair
+#define MAX_MATERIALS 1024u
+
+struct Material {
+    vec4 color;
+    uint texture;
+};
+
+layout(binding = 0) uniform uMaterials {
+    Material materials[MAX_MATERIALS];
+};
+
+struct ChunkInfo {
+    vec4 boundsMin;
+    vec4 boundsMax;
+    vec4 position;
+};
+
+layout(std430, binding = 1) readonly buffer uChunks {
+    ChunkInfo chunks[];
+};
+
+// written by visibility.frag
+uniform usampler2D uVoxelIds;
+uniform sampler2D uDepth;
+
+uniform sampler2DArray uTextures;
+
+uniform mat4 uInvProjectionView;
+uniform vec3 uCameraPosition;
+
+uniform vec2 uViewportSize;
+
+uniform float uReach;
+
+// +x, -x, +y, -y, +z, -z like NEIGHBOR_OFFSETS
+const vec3 NORMALS[6] = vec3[](
+    vec3(1.0, 0.0, 0.0), vec3(-1.0, 0.0, 0.0),
+    vec3(0.0, 1.0, 0.0), vec3(0.0, -1.0, 0.0),
+    vec3(0.0, 0.0, 1.0), vec3(0.0, 0.0, -1.0)
+);
+
+out vec4 outColor;
+
+float maxComponent(vec3 a) {
+    return max(a.x, max(a.y, a.z));
+}
+
+void main(void) {
+    vec3 light = normalize(vec3(0.3, 1.0, -0.5));
+
+    ivec2 pixel = ivec2(gl_FragCoord.xy);
+    uvec2 id = texelFetch(uVoxelIds, pixel, 0).xy;
+    if (id.x == UINT_MAX)
+        discard;
+    gl_FragDepth = texelFetch(uDepth, pixel, 0).r;
+
+    uvec3 local = (uvec3(id.x) >> uvec3(12, 6, 0)) & 0x3Fu;
+    uint face = (id.x >> 18) & 0x7u;
+    float voxelScale = float(1u << ((id.x >> 21) & 0x3u));
+    uint chunk = id.y >> 10;
+    uint material = id.y & 0x3FFu;
+
+    vec3 center = (vec3(local) + vec3(0.5)) * voxelScale + chunks[chunk].position.xyz - uCameraPosition;
+    float radius = 0.5 * voxelScale;
+    vec3 normal = NORMALS[face];
+    int axis = int(face / 2u);
+
+    // the face is already known, so only its plane is intersected, the far one when the camera
+    // is inside the voxel like in screen.frag
+    vec2 screenPosition = gl_FragCoord.xy / uViewportSize * 2.0 - 1.0;
+    vec3 direction = vec3(uInvProjectionView * vec4(screenPosition, -1.0, 1.0));
+    float winding = maxComponent(abs(center)) < radius ? -1.0 : 1.0;
+    float distance = (center[axis] + normal[axis] * radius * winding) / direction[axis];
+    vec3 f = clamp((direction * distance - center + radius) / voxelScale, 0.0, 1.0);
+
+    vec2 textureCoord;
+    if (normal.x > 0)
+        textureCoord = vec2(1.0 - f.z, f.y);
+    else if (normal.x < 0)
+        textureCoord = f.zy;
+    else if (normal.y > 0)
+        textureCoord = vec2(1.0 - f.x, f.z);
+    else if (normal.y < 0)
+        textureCoord = f.xz;
+    else if (normal.z > 0)
+        textureCoord = f.xy;
+    else
+        textureCoord = vec2(1.0 - f.x, f.y);
+
+    vec3 color = materials[material].color.xyz;
+    vec3 lightColor = vec3(1.0, 1.0, 1.0);
+    vec3 ambient = vec3(0.1, 0.1, 0.1);
+    vec3 diffuse = lightColor * max(dot(normal, light), 0.0);
+    outColor = vec4(color * (ambient + diffuse), 1.0);
+
+#ifndef UNTEXTURED
+    uint textureIndex = materials[material].texture;
+    if (textureIndex != UINT_MAX)
+        outColor *= texture(uTextures, vec3(textureCoord, textureIndex));
+#endif
+
+#ifndef NO_CROSSHAIR
+    // draw a circular crosshair mid-screen
+    vec2 aspect = vec2(uViewportSize.x / uViewportSize.y, 1.0);
+    if (length((gl_FragCoord.xy / uViewportSize * aspect) - (aspect * 0.5)) < 0.005) {
+        if (distance < uReach) {
+            outColor = mix(vec4(0.0, 1.0, 0.2, 1.0), outColor, 0.5);
+        } else {
+            outColor = mix(vec4(1.0, 0.0, 0.2, 1.0), outColor, 0.5);
+        }
+    }
+#endif
+}
@@ -1,23 +1,36 @@
-#version 330
+#version 450
 
 #define UINT_MAX 4294967295u
 
+// variants, see ShaderVariants: AXIS_ALIGNED skips the box rotation, UNTEXTURED the texture lookup,
+// NO_CROSSHAIR the crosshair and DEPTH_ONLY everything but the depth of the hit for the depth prepass,
+// which then matches the depth of the shading pass exactly as long as both agree on AXIS_ALIGNED
+#ifdef AXIS_ALIGNED
+#define ORIENTED false
+#else
+#define ORIENTED true
+#endif
+
 in vec3 vPosition;
 in vec3 vColor;
 flat in uint vTextureIndex;
+flat in float vVoxelScale;
 
 uniform sampler2DArray uTextures;
 
+uniform mat4 uProjectionView;
 uniform mat4 uInvProjectionView;
 
 uniform vec2 uViewportSize;
-uniform float uNearPlane;
-uniform float uFarPlane;
 
 uniform float uReach;
 
 out vec4 outColor;
 
+// the billboard is rasterized at the nearest depth the voxel can have, so the hit is never
+// closer and the early depth test stays enabled even though the depth is written
+layout(depth_greater) out float gl_FragDepth;
+
 struct Box {
     vec3     center;
     vec3     radius;
@@ -43,9 +56,11 @@ bool intersectBox(Box box, Ray ray, out float distance, out vec3 normal, out vec
     vec3 invRayDirection = 1.0 / ray.direction;
 
     // Move to the box's reference frame. This is unavoidable and un-optimizable.
-    ray.origin = box.rotation * (ray.origin - box.center);
     if (oriented) {
+        ray.origin = box.rotation * (ray.origin - box.center);
         ray.direction = ray.direction * box.rotation;
+    } else {
+        ray.origin = ray.origin - box.center;
     }
 
     // This "rayCanStartInBox" branch is evaluated at compile time because `const` in GLSL
@@ -66,7 +81,7 @@ bool intersectBox(Box box, Ray ray, out float distance, out vec3 normal, out vec
 
     // Ray-plane intersection. For each pair of planes, choose the one that is front-facing
     // to the ray and compute the distance to it.
-    vec3 distanceToPlane = box.radius * winding * sgn - ray.origin;
+    precise vec3 distanceToPlane = box.radius * winding * sgn - ray.origin;
     if (oriented) {
         distanceToPlane /= ray.direction;
     } else {
@@ -143,7 +158,7 @@ void main(void) {
 
     Box box;
     box.center = vPosition;
-    box.radius = vec3(0.5, 0.5, 0.5);
+    box.radius = vec3(0.5 * vVoxelScale);
     box.invRadius = 1.0 / box.radius;
     box.rotation = mat3(1.0);
 
@@ -151,10 +166,11 @@ void main(void) {
     vec3 normal;
     vec2 textureCoord;
 
-    if (intersectBox(box, ray, distance, normal, textureCoord, true, true)) {
-        // overwriting the depth buffer breaks the early depth test
-        // causing significant performance loss
-        // gl_FragDepth = (distance - uNearPlane) / (uFarPlane - uNearPlane);
+    if (intersectBox(box, ray, distance, normal, textureCoord, true, ORIENTED)) {
+        precise vec4 hit = uProjectionView * vec4(ray.direction * distance, 1.0);
+        gl_FragDepth = max(hit.z / hit.w * 0.5 + 0.5, gl_FragCoord.z);
+
+#ifndef DEPTH_ONLY
 
         // calculate the color and lighting
         vec3 color = vColor;
@@ -165,9 +181,12 @@ void main(void) {
         vec3 finalColor = color * (ambient + diffuse + specular);
         outColor = vec4(finalColor, 1.0);
 
+#ifndef UNTEXTURED
         if (vTextureIndex != UINT_MAX)
             outColor *= texture(uTextures, vec3(textureCoord, vTextureIndex));
+#endif
 
+#ifndef NO_CROSSHAIR
         // draw a circular crosshair mid-screen
         vec2 aspect = vec2(uViewportSize.x / uViewportSize.y, 1.0);
         if (length((gl_FragCoord.xy / uViewportSize * aspect) - (aspect * 0.5)) < 0.005) {
@@ -177,7 +196,8 @@ void main(void) {
                 outColor = mix(vec4(1.0, 0.0, 0.2, 1.0), outColor, 0.5);
             }
         }
-
+#endif
+#endif
     } else {
         discard;
     }
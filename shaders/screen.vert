@@ -1,10 +1,18 @@
 #version 450
+#extension GL_ARB_shader_draw_parameters : enable
 
 #define MAX_MATERIALS 1024u
+// packing of the chunk entry of a draw command, see draw_command.h
+#define DRAW_CHUNK_MASK 0x7FFFFFFu
+#define DRAW_LEVEL_SHIFT 27
+#define DRAW_ORDER_SHIFT 29
+#define DRAW_REVERSED 0x80000000u
 
-layout(location = 0) in vec3 aBillboardPosition;
-layout(location = 1) in uint aPackedVoxelPosition;
-layout(location = 2) in uint aMaterialIndex;
+// corners of the two triangles of a billboard, picked by gl_VertexID
+const vec2 BILLBOARD_CORNERS[6] = vec2[6](
+    vec2(-1.0, 1.0), vec2(-1.0, -1.0), vec2(1.0, -1.0),
+    vec2(1.0, -1.0), vec2(1.0, 1.0), vec2(-1.0, 1.0)
+);
 
 struct Material {
     vec4 color;
@@ -18,12 +26,58 @@ layout(binding = 0) uniform uMaterials {
 uniform mat4 uProjectionView;
 uniform vec3 uCameraPosition;
 
+struct ChunkInfo {
+    vec4 boundsMin;
+    vec4 boundsMax;
+    vec4 position;
+};
+
+layout(std430, binding = 1) readonly buffer uChunks {
+    ChunkInfo chunks[];
+};
+
+// chunk index, level and instance order of every command of a multi draw, starting at uDrawOffset
+layout(std430, binding = 2) readonly buffer uDrawChunks {
+    uint drawChunks[];
+};
+
+// packed position and material of the voxels of all chunks, see Voxel
+layout(std430, binding = 4) readonly buffer uInstances {
+    uvec2 instances[];
+};
+
+// offsets from every instance slot to the instance drawn there in orders 1 to 3, see InstanceOrder
+layout(std430, binding = 5) readonly buffer uInstanceOrders {
+    uvec2 instanceOrders[];
+};
+
 uniform vec3 uChunkPosition;
 uniform float uChunkSize;
+// index of the chunk in uChunks, for the visibility buffer
+uniform int uChunkIndex;
+// edge length of a voxel, 2^level for coarser levels of detail
+uniform float uVoxelScale;
+// first instance of the drawn range, gl_InstanceID doesn't include the base instance of the command
+uniform int uBaseInstance;
+
+// chunks drawn by one multi draw call look their position, scale and instance order up by draw id instead
+uniform bool uMultiDraw;
+uniform int uDrawOffset;
+
+// one GL_POINTS vertex per voxel whose square covers the rectangle, instead of two triangles
+uniform bool uPointSprites;
+uniform vec2 uViewportSize;
+uniform float uMaxPointSize;
+
+// the depth prepass rasterizes exactly the same billboards
+invariant gl_Position;
 
 out vec3 vPosition;
 out vec3 vColor;
 flat out uint vTextureIndex;
+flat out float vVoxelScale;
+// chunk local position and level, chunk index and material, see visibility.frag
+flat out uvec2 vVoxelId;
 
 vec3 unpackPosition(in uint packedPosition) {
     // x 10 bits, y 10 bits, z 10 bits
@@ -45,18 +99,101 @@ vec4 unpackUnorm4x8(in uint packedColor) {
 }
 
 void main(void) {
-    vec3 voxelPosition = unpackPosition(aPackedVoxelPosition) + vec3(0.5) + uChunkPosition * uChunkSize - uCameraPosition;
-    vec3 voxelColor = materials[aMaterialIndex].color.xyz;
+    vec3 chunkOrigin = uChunkPosition * uChunkSize;
+    float voxelScale = uVoxelScale;
+    uint chunkIndex = uint(uChunkIndex);
+    uint baseInstance = uint(uBaseInstance);
+    bool reversed = false;
+    uint order = 0u;
+#ifdef GL_ARB_shader_draw_parameters
+    if (uMultiDraw) {
+        uint drawChunk = drawChunks[uDrawOffset + gl_DrawIDARB];
+        chunkIndex = drawChunk & DRAW_CHUNK_MASK;
+        chunkOrigin = chunks[chunkIndex].position.xyz;
+        voxelScale = float(1u << ((drawChunk >> DRAW_LEVEL_SHIFT) & 3u));
+        order = (drawChunk >> DRAW_ORDER_SHIFT) & 3u;
+        reversed = (drawChunk & DRAW_REVERSED) != 0u;
+        baseInstance = uint(gl_BaseInstanceARB);
+    }
+#endif
 
-    vec3 viewDir = normalize(-voxelPosition);
-    vec3 right = normalize(cross(vec3(0, 1, 0), viewDir));
-    vec3 up = normalize(cross(viewDir, right));
+    // commands walked backwards start at the last instance of their cluster
+    uint slot = reversed ? baseInstance - uint(gl_InstanceID) : baseInstance + uint(gl_InstanceID);
+    if (order != 0u) {
+        uvec2 offsets = instanceOrders[slot];
+        slot += uint(bitfieldExtract(int(order == 3u ? offsets.y : offsets.x), order == 2u ? 16 : 0, 16));
+    }
+    uvec2 instance = instances[slot];
+    uint packedPosition = instance.x;
+    uint materialIndex = instance.y;
+    vec2 billboardCorner = BILLBOARD_CORNERS[gl_VertexID] * 0.86602540378;
 
-    vec3 billboardPos = (voxelPosition + aBillboardPosition.x * right + aBillboardPosition.y * up);
+    vec3 voxelPosition = (unpackPosition(packedPosition) + vec3(0.5)) * voxelScale + chunkOrigin - uCameraPosition;
+    vec3 voxelColor = materials[materialIndex].color.xyz;
 
-    gl_Position = uProjectionView * vec4(billboardPos, 1.0);
+    // the rectangle around the projected corners of the cube at the depth of the nearest one covers
+    // far fewer pixels than any camera facing billboard, corners are the center plus or minus the
+    // projected half axes
+    vec4 center = uProjectionView * vec4(voxelPosition, 1.0);
+    vec4 axisX = uProjectionView[0] * (0.5 * voxelScale);
+    vec4 axisY = uProjectionView[1] * (0.5 * voxelScale);
+    vec4 axisZ = uProjectionView[2] * (0.5 * voxelScale);
+    vec2 rectMin = vec2(1e30);
+    vec2 rectMax = vec2(-1e30);
+    float nearest = 1.0;
+    bool inFront = true;
+    for (int i = 0; i < 8; ++i) {
+        vec4 corner = center + ((i & 1) != 0 ? axisX : -axisX)
+                             + ((i & 2) != 0 ? axisY : -axisY)
+                             + ((i & 4) != 0 ? axisZ : -axisZ);
+        // in front of the near plane or behind the camera
+        if (corner.z < -corner.w) {
+            inFront = false;
+            break;
+        }
+        vec2 ndc = corner.xy / corner.w;
+        rectMin = min(rectMin, ndc);
+        rectMax = max(rectMax, ndc);
+        nearest = min(nearest, corner.z / corner.w);
+    }
+
+    if (uPointSprites) {
+        // points are clipped by their center and can't fall back to a billboard, voxels reaching
+        // behind the near plane or larger than the largest point are left with holes
+        vec2 size = (rectMax - rectMin) * 0.5 * uViewportSize;
+        gl_Position = inFront ? vec4((rectMin + rectMax) * 0.5, nearest, 1.0) : vec4(0.0, 0.0, 2.0, 1.0);
+        gl_PointSize = min(max(size.x, size.y), uMaxPointSize);
+    } else if (inFront) {
+        gl_Position = vec4(mix(rectMin, rectMax, greaterThan(billboardCorner, vec2(0.0))), nearest, 1.0);
+    } else {
+        // the camera is right next to the voxel, fall back to a billboard in front of its bounding sphere,
+        // the silhouette cone has a half angle of asin(r / d) which at distance d - r is a radius of
+        // r * sqrt((d - r) / (d + r))
+        vec3 viewDir = normalize(-voxelPosition);
+        vec3 right = normalize(cross(vec3(0, 1, 0), viewDir));
+        vec3 up = normalize(cross(viewDir, right));
+
+        float radius = 0.86602540378 * voxelScale;
+        float distance = length(voxelPosition);
+        vec3 billboardCenter = voxelPosition;
+        float scale = 1.0;
+        if (distance > radius * 1.001) {
+            billboardCenter += viewDir * radius;
+            scale = sqrt((distance - radius) / (distance + radius));
+        }
+
+        vec3 billboardPos = billboardCenter + (billboardCorner.x * right + billboardCorner.y * up) * scale * voxelScale;
+        gl_Position = uProjectionView * vec4(billboardPos, 1.0);
+    }
 
     vPosition = voxelPosition;
     vColor = voxelColor;
-    vTextureIndex = materials[aMaterialIndex].texture;
+    vTextureIndex = materials[materialIndex].texture;
+    vVoxelScale = voxelScale;
+
+    // positions of a level fit in 6 bits per axis
+    uvec3 local = (uvec3(packedPosition) >> uvec3(20, 10, 0)) & 0x3Fu;
+    uint level = findLSB(uint(voxelScale));
+    vVoxelId = uvec2((local.x << 12) | (local.y << 6) | local.z | (level << 21),
+                     (chunkIndex << 10) | materialIndex);
 }
\ No newline at end of file
@@ -0,0 +1,71 @@
+#version 450
+
+// share of this frame's sample in the output, from a sample far from the pixel to one right on it
+#define MIN_BLEND 0.03
+#define MAX_BLEND 0.3
+
+// the frame rendered at the internal resolution with a sub-pixel jitter
+uniform sampler2D uColor;
+uniform sampler2D uDepth;
+// the reconstructed output of the last frame, sampled bilinearly
+uniform sampler2D uHistory;
+uniform bool uHistoryValid;
+
+uniform vec2 uRenderSize;
+uniform vec2 uOutputSize;
+// offset of this frame's image in internal pixels
+uniform vec2 uJitter;
+
+// without jitter, relative to the camera position of each frame
+uniform mat4 uInvProjectionView;
+uniform mat4 uPreviousProjectionView;
+// camera position of this frame minus that of the last one
+uniform vec3 uCameraOffset;
+
+out vec4 outColor;
+
+void main(void) {
+    vec2 uv = gl_FragCoord.xy / uOutputSize;
+    ivec2 texel = min(ivec2(uv * uRenderSize), ivec2(uRenderSize) - 1);
+    vec3 current = texelFetch(uColor, texel, 0).rgb;
+
+    // the history is clipped to the colors around the sample to reject what has changed since, to
+    // their mean plus or minus their standard deviation, which is much tighter than their bounds
+    // where bright and dark texels mix
+    vec3 mean = vec3(0.0);
+    vec3 meanSquared = vec3(0.0);
+    for (int y = -1; y <= 1; ++y) {
+        for (int x = -1; x <= 1; ++x) {
+            vec3 color = texelFetch(uColor, clamp(texel + ivec2(x, y), ivec2(0), ivec2(uRenderSize) - 1), 0).rgb;
+            mean += color;
+            meanSquared += color * color;
+        }
+    }
+    mean /= 9.0;
+    vec3 deviation = sqrt(max(meanSquared / 9.0 - mean * mean, 0.0));
+    vec3 minColor = mean - deviation;
+    vec3 maxColor = mean + deviation;
+
+    if (!uHistoryValid) {
+        outColor = vec4(current, 1.0);
+        return;
+    }
+
+    // the voxels don't move, so the motion of every pixel follows from its depth and the two cameras
+    float depth = texelFetch(uDepth, texel, 0).r;
+    vec4 position = uInvProjectionView * vec4(uv * 2.0 - 1.0, depth * 2.0 - 1.0, 1.0);
+    vec4 previous = uPreviousProjectionView * vec4(position.xyz / position.w + uCameraOffset, 1.0);
+    vec2 previousUv = previous.xy / previous.w * 0.5 + 0.5;
+    if (previous.w <= 0.0 || any(lessThan(previousUv, vec2(0.0))) || any(greaterThan(previousUv, vec2(1.0)))) {
+        outColor = vec4(current, 1.0);
+        return;
+    }
+    vec3 history = clamp(texture(uHistory, previousUv).rgb, minColor, maxColor);
+
+    // the sample of the texel was taken where the jitter moved its center to, the closer that is to
+    // this pixel the more it contributes, a gaussian fit of Blackman-Harris in output pixels
+    vec2 samplePosition = (vec2(texel) + 0.5 - uJitter) / uRenderSize;
+    vec2 offset = (uv - samplePosition) * uOutputSize;
+    float weight = exp(-2.29 * dot(offset, offset));
+    outColor = vec4(mix(history, current, mix(MIN_BLEND, MAX_BLEND, weight)), 1.0);
+}
@@ -0,0 +1,53 @@
+#version 450
+
+in vec3 vPosition;
+flat in float vVoxelScale;
+flat in uvec2 vVoxelId;
+
+uniform mat4 uProjectionView;
+uniform mat4 uInvProjectionView;
+
+uniform vec2 uViewportSize;
+
+// x: chunk local position 6 bits per axis, the face in NEIGHBOR_OFFSETS order 3 bits from bit 18
+// and the level 2 bits from bit 21, y: chunk index above the 10 bit material, all bits set where
+// nothing was hit. shading is left to resolve.frag, which runs once per pixel
+out uvec2 outVoxelId;
+
+layout(depth_greater) out float gl_FragDepth;
+
+float maxComponent(vec3 a) {
+    return max(a.x, max(a.y, a.z));
+}
+
+float minComponent(vec3 a) {
+    return min(a.x, min(a.y, a.z));
+}
+
+void main(void) {
+    vec2 screenPosition = gl_FragCoord.xy / uViewportSize * 2.0 - 1.0;
+    vec3 direction = vec3(uInvProjectionView * vec4(screenPosition, -1.0, 1.0));
+
+    // the same slabs as intersectBox in screen.frag with an axis aligned box, the far face is hit
+    // when the camera is inside the voxel and like there the normal always faces the camera
+    vec3 radius = vec3(0.5 * vVoxelScale);
+    vec3 tNear = (vPosition - radius * sign(direction)) / direction;
+    vec3 tFar = (vPosition + radius * sign(direction)) / direction;
+    float entry = maxComponent(tNear);
+    float exit = minComponent(tFar);
+    if (entry > exit || exit < 0.0)
+        discard;
+
+    float distance = entry;
+    int axis = tNear.x == entry ? 0 : (tNear.y == entry ? 1 : 2);
+    if (entry < 0.0) {
+        distance = exit;
+        axis = tFar.x == exit ? 0 : (tFar.y == exit ? 1 : 2);
+    }
+
+    vec4 hit = uProjectionView * vec4(direction * distance, 1.0);
+    gl_FragDepth = max(hit.z / hit.w * 0.5 + 0.5, gl_FragCoord.z);
+
+    uint face = uint(axis * 2 + (direction[axis] < 0.0 ? 0 : 1));
+    outVoxelId = uvec2(vVoxelId.x | (face << 18), vVoxelId.y);
+}
@@ -57,6 +57,35 @@ public:
         }
     }
 
+    template<typename T>
+    void setSubData(GLintptr offset, const T *data, GLsizeiptr n) {
+        glNamedBufferSubData(m_id, offset, n, data);
+    }
+
+    // grows the storage without uploading anything, previous contents are lost on growth
+    void reserve(GLsizeiptr n) {
+        if (n > m_capacity) {
+            glNamedBufferData(m_id, n, nullptr, static_cast<GLenum>(m_usage));
+            m_capacity = n;
+        }
+        m_size = n;
+    }
+
+    // grows the storage keeping the contents, the buffer gets a new id so bindings have to be renewed
+    void grow(GLsizeiptr n) {
+        if (n <= m_capacity)
+            return;
+        GLuint id;
+        glCreateBuffers(1, &id);
+        glNamedBufferData(id, n, nullptr, static_cast<GLenum>(m_usage));
+        if (m_size > 0)
+            glCopyNamedBufferSubData(m_id, id, 0, 0, m_size);
+        glDeleteBuffers(1, &m_id);
+        m_id = id;
+        m_capacity = n;
+        m_size = n;
+    }
+
 private:
     GLuint m_id{0};
     GLsizeiptr m_size{0};
@@ -3,6 +3,8 @@
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 
+#include "frustum.h"
+
 class Camera {
 public:
     Camera() = default;
@@ -11,6 +13,11 @@ public:
         m_projection = glm::perspective(fov, aspect, near, far);
     }
 
+    // shifts the image by offset in normalized device coordinates, for sub-pixel jitter
+    void setJitter(const glm::vec2 &offset) {
+        m_jitter = offset;
+    }
+
     void setDirection(const glm::vec3 &direction) {
         m_direction = direction;
     }
@@ -19,12 +26,25 @@ public:
         m_position = position;
     }
 
+    [[nodiscard]] glm::mat4 getProjectionMatrix() const {
+        // clip space w is the negated view space z
+        glm::mat4 projection = m_projection;
+        projection[2][0] -= m_jitter.x;
+        projection[2][1] -= m_jitter.y;
+        return projection;
+    }
+
     [[nodiscard]] glm::mat4 getProjectionViewMatrix() const {
-        return m_projection * glm::lookAt(glm::vec3(0), m_direction, glm::vec3(0, 1, 0));
+        return getProjectionMatrix() * glm::lookAt(glm::vec3(0), m_direction, glm::vec3(0, 1, 0));
     }
 
     [[nodiscard]] glm::mat4 getInverseProjectionViewMatrix() const {
-        return glm::inverse(m_projection * glm::lookAt(glm::vec3(0), m_direction, glm::vec3(0, 1, 0)));
+        return glm::inverse(getProjectionViewMatrix());
+    }
+
+    // frustum in world space, the projection view matrix is relative to the camera position
+    [[nodiscard]] Frustum getFrustum() const {
+        return Frustum::fromMatrix(getProjectionViewMatrix()).translated(m_position);
     }
 
     [[nodiscard]] glm::vec3 getDirection() const {
@@ -37,6 +57,7 @@ public:
 
 private:
     glm::mat4 m_projection{1.0f};
+    glm::vec2 m_jitter{0.0f};
     glm::vec3 m_direction{0.0f, 0.0f, 1.0f};
     glm::vec3 m_position{0.0f};
 };
@@ -0,0 +1,20 @@
+#pragma once
+
+#include <GL/glew.h>
+
+// layout expected by glDrawArraysIndirect and friends
+struct DrawArraysIndirectCommand {
+    GLuint count;
+    GLuint instanceCount;
+    GLuint first;
+    GLuint baseInstance;
+};
+
+// the chunk entry of a command of a multi draw, which the vertex shader looks up by draw id: the
+// chunk index, its level and the instance order its cluster is drawn in, see INSTANCE_ORDERS. the
+// instances of reversed commands are walked backwards from their base instance. matches screen.vert
+// and cull.comp
+constexpr GLuint DRAW_CHUNK_MASK = 0x7FFFFFFu;
+constexpr GLuint DRAW_LEVEL_SHIFT = 27;
+constexpr GLuint DRAW_ORDER_SHIFT = 29;
+constexpr GLuint DRAW_REVERSED = 0x80000000u;
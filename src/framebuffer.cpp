@@ -0,0 +1,74 @@
+
+#include "framebuffer.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+Framebuffer::Framebuffer(int width, int height, GLenum colorFormat)
+    : m_width(width), m_height(height), m_colorFormat(colorFormat) {
+    create();
+}
+
+Framebuffer::~Framebuffer() {
+    destroy();
+}
+
+void Framebuffer::resize(int width, int height) {
+    if (width == m_width && height == m_height)
+        return;
+    destroy();
+    m_width = width;
+    m_height = height;
+    create();
+}
+
+void Framebuffer::create() {
+    glCreateTextures(GL_TEXTURE_2D, 1, &m_colorTexture);
+    glTextureStorage2D(m_colorTexture, 1, m_colorFormat, m_width, m_height);
+    glTextureParameteri(m_colorTexture, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTextureParameteri(m_colorTexture, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+
+    glCreateTextures(GL_TEXTURE_2D, 1, &m_depthTexture);
+    glTextureStorage2D(m_depthTexture, 1, GL_DEPTH_COMPONENT32F, m_width, m_height);
+    glTextureParameteri(m_depthTexture, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTextureParameteri(m_depthTexture, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+
+    glCreateFramebuffers(1, &m_id);
+    glNamedFramebufferTexture(m_id, GL_COLOR_ATTACHMENT0, m_colorTexture, 0);
+    glNamedFramebufferTexture(m_id, GL_DEPTH_ATTACHMENT, m_depthTexture, 0);
+
+    if (glCheckNamedFramebufferStatus(m_id, GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+        throw std::runtime_error("Framebuffer: incomplete framebuffer");
+    }
+}
+
+void Framebuffer::destroy() {
+    glDeleteFramebuffers(1, &m_id);
+    glDeleteTextures(1, &m_colorTexture);
+    glDeleteTextures(1, &m_depthTexture);
+}
+
+void Framebuffer::bind() const {
+    glBindFramebuffer(GL_FRAMEBUFFER, m_id);
+    glViewport(0, 0, m_width, m_height);
+}
+
+void Framebuffer::bindDefault(int width, int height) {
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glViewport(0, 0, width, height);
+}
+
+void Framebuffer::readPixels(std::vector<uint8_t> &pixels) const {
+    const size_t rowSize = static_cast<size_t>(m_width) * 4;
+    std::vector<uint8_t> flipped(rowSize * m_height);
+    pixels.resize(flipped.size());
+
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    glGetTextureImage(m_colorTexture, 0, GL_RGBA, GL_UNSIGNED_BYTE,
+                      static_cast<GLsizei>(flipped.size()), flipped.data());
+
+    // OpenGL stores the bottom row first
+    for (int y = 0; y < m_height; ++y) {
+        std::copy_n(flipped.data() + (m_height - 1 - y) * rowSize, rowSize, pixels.data() + y * rowSize);
+    }
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <GL/glew.h>
+
+#include <vector>
+#include <cstdint>
+
+// Offscreen render target with a color and a sampleable depth texture.
+class Framebuffer {
+public:
+    Framebuffer(int width, int height, GLenum colorFormat = GL_RGBA8);
+
+    ~Framebuffer();
+
+    Framebuffer(const Framebuffer &other) = delete;
+
+    Framebuffer &operator=(const Framebuffer &other) = delete;
+
+    // reallocates both textures, their contents are lost
+    void resize(int width, int height);
+
+    void bind() const;
+
+    static void bindDefault(int width, int height);
+
+    // reads back the color attachment as tightly packed RGBA rows, top row first
+    void readPixels(std::vector<uint8_t> &pixels) const;
+
+    [[nodiscard]] GLuint getId() const {
+        return m_id;
+    }
+
+    [[nodiscard]] GLuint getColorTexture() const {
+        return m_colorTexture;
+    }
+
+    [[nodiscard]] GLuint getDepthTexture() const {
+        return m_depthTexture;
+    }
+
+    [[nodiscard]] int getWidth() const {
+        return m_width;
+    }
+
+    [[nodiscard]] int getHeight() const {
+        return m_height;
+    }
+
+private:
+    GLuint m_id{0};
+    GLuint m_colorTexture{0};
+    GLuint m_depthTexture{0};
+    int m_width;
+    int m_height;
+    GLenum m_colorFormat;
+
+    void create();
+
+    void destroy();
+};
@@ -0,0 +1,117 @@
+
+#include "frustum.h"
+
+#include <limits>
+
+#if defined(__SSE__) || defined(_M_X64)
+#include <xmmintrin.h>
+#define FRUSTUM_SSE
+#endif
+
+Frustum Frustum::fromMatrix(const glm::mat4 &projectionView) {
+    // Gribb-Hartmann plane extraction, glm matrices are column major
+    glm::vec4 row0(projectionView[0][0], projectionView[1][0], projectionView[2][0], projectionView[3][0]);
+    glm::vec4 row1(projectionView[0][1], projectionView[1][1], projectionView[2][1], projectionView[3][1]);
+    glm::vec4 row2(projectionView[0][2], projectionView[1][2], projectionView[2][2], projectionView[3][2]);
+    glm::vec4 row3(projectionView[0][3], projectionView[1][3], projectionView[2][3], projectionView[3][3]);
+
+    Frustum frustum{};
+    frustum.planes[0] = row3 + row0; // left
+    frustum.planes[1] = row3 - row0; // right
+    frustum.planes[2] = row3 + row1; // bottom
+    frustum.planes[3] = row3 - row1; // top
+    frustum.planes[4] = row3 + row2; // near
+    frustum.planes[5] = row3 - row2; // far
+
+    for (auto &plane: frustum.planes) {
+        plane /= glm::length(glm::vec3(plane));
+    }
+    return frustum;
+}
+
+Frustum Frustum::translated(const glm::vec3 &offset) const {
+    Frustum frustum = *this;
+    for (auto &plane: frustum.planes) {
+        plane.w -= glm::dot(glm::vec3(plane), offset);
+    }
+    return frustum;
+}
+
+bool Frustum::intersects(const glm::vec3 &min, const glm::vec3 &max) const {
+    for (auto &plane: planes) {
+        // the corner furthest along the plane normal
+        glm::vec3 corner(plane.x > 0.0f ? max.x : min.x,
+                         plane.y > 0.0f ? max.y : min.y,
+                         plane.z > 0.0f ? max.z : min.z);
+        if (glm::dot(glm::vec3(plane), corner) + plane.w < 0.0f)
+            return false;
+    }
+    return true;
+}
+
+size_t BoundingBoxes::add(const glm::vec3 &min, const glm::vec3 &max) {
+    size_t index = m_count++;
+    size_t padded = (m_count + 3) & ~size_t(3);
+    m_minX.resize(padded);
+    m_minY.resize(padded);
+    m_minZ.resize(padded);
+    m_maxX.resize(padded);
+    m_maxY.resize(padded);
+    m_maxZ.resize(padded);
+    set(index, min, max);
+    return index;
+}
+
+void BoundingBoxes::set(size_t index, const glm::vec3 &min, const glm::vec3 &max) {
+    m_minX[index] = min.x;
+    m_minY[index] = min.y;
+    m_minZ[index] = min.z;
+    m_maxX[index] = max.x;
+    m_maxY[index] = max.y;
+    m_maxZ[index] = max.z;
+}
+
+void BoundingBoxes::setEmpty(size_t index) {
+    // inverted box, the positive vertex lies behind every plane
+    // FLT_MAX rather than infinity so that 0 * bound stays 0 instead of nan
+    constexpr float big = std::numeric_limits<float>::max();
+    set(index, glm::vec3(big), glm::vec3(-big));
+}
+
+void BoundingBoxes::cull(const Frustum &frustum, std::vector<uint8_t> &visible) const {
+    visible.resize(m_minX.size());
+
+    // for every plane only the box corner furthest along the normal needs testing,
+    // which one that is only depends on the signs of the normal
+#ifdef FRUSTUM_SSE
+    for (size_t i = 0; i < m_minX.size(); i += 4) {
+        __m128 inside = _mm_cmpeq_ps(_mm_setzero_ps(), _mm_setzero_ps());
+        for (auto &plane: frustum.planes) {
+            __m128 x = _mm_loadu_ps(plane.x > 0.0f ? &m_maxX[i] : &m_minX[i]);
+            __m128 y = _mm_loadu_ps(plane.y > 0.0f ? &m_maxY[i] : &m_minY[i]);
+            __m128 z = _mm_loadu_ps(plane.z > 0.0f ? &m_maxZ[i] : &m_minZ[i]);
+            __m128 distance = _mm_add_ps(
+                _mm_add_ps(_mm_mul_ps(x, _mm_set1_ps(plane.x)), _mm_mul_ps(y, _mm_set1_ps(plane.y))),
+                _mm_add_ps(_mm_mul_ps(z, _mm_set1_ps(plane.z)), _mm_set1_ps(plane.w)));
+            inside = _mm_and_ps(inside, _mm_cmpge_ps(distance, _mm_setzero_ps()));
+        }
+        int mask = _mm_movemask_ps(inside);
+        visible[i] = mask & 1;
+        visible[i + 1] = (mask >> 1) & 1;
+        visible[i + 2] = (mask >> 2) & 1;
+        visible[i + 3] = (mask >> 3) & 1;
+    }
+#else
+    for (size_t i = 0; i < m_minX.size(); ++i) {
+        bool inside = true;
+        for (auto &plane: frustum.planes) {
+            float x = plane.x > 0.0f ? m_maxX[i] : m_minX[i];
+            float y = plane.y > 0.0f ? m_maxY[i] : m_minY[i];
+            float z = plane.z > 0.0f ? m_maxZ[i] : m_minZ[i];
+            inside &= plane.x * x + plane.y * y + plane.z * z + plane.w >= 0.0f;
+        }
+        visible[i] = inside;
+    }
+#endif
+    visible.resize(m_count);
+}
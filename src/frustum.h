@@ -0,0 +1,45 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <array>
+#include <vector>
+#include <cstdint>
+
+struct Frustum {
+    // a * x + b * y + c * z + d >= 0 for points inside, normals point inwards
+    std::array<glm::vec4, 6> planes;
+
+    static Frustum fromMatrix(const glm::mat4 &projectionView);
+
+    // moves the frustum by offset, e.g. from camera relative to world space
+    [[nodiscard]] Frustum translated(const glm::vec3 &offset) const;
+
+    // false only if the box is completely outside one of the planes
+    [[nodiscard]] bool intersects(const glm::vec3 &min, const glm::vec3 &max) const;
+};
+
+// Axis aligned boxes stored as a structure of arrays so they can be culled
+// four at a time with SSE.
+class BoundingBoxes {
+public:
+    size_t add(const glm::vec3 &min, const glm::vec3 &max);
+
+    void set(size_t index, const glm::vec3 &min, const glm::vec3 &max);
+
+    // empty boxes are never visible
+    void setEmpty(size_t index);
+
+    // writes 1 for every box that intersects the frustum and 0 otherwise
+    void cull(const Frustum &frustum, std::vector<uint8_t> &visible) const;
+
+    [[nodiscard]] size_t size() const {
+        return m_count;
+    }
+
+private:
+    // padded to a multiple of 4
+    std::vector<float> m_minX, m_minY, m_minZ;
+    std::vector<float> m_maxX, m_maxY, m_maxZ;
+    size_t m_count{0};
+};
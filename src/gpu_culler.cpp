@@ -0,0 +1,200 @@
+
+#include "gpu_culler.h"
+
+#include <cstddef>
+#include <vector>
+
+#include "draw_command.h"
+
+// matches BANDS and GROUP_SIZE in order.comp
+constexpr size_t ORDER_BANDS = 256;
+constexpr size_t ORDER_GROUP_SIZE = 256;
+
+struct Counters {
+    GLuint drawCounts[2];
+    CullingStats stats;
+};
+
+GpuCuller::GpuCuller(int width, int height)
+    : m_width(width), m_height(height),
+      m_hiZBuffer(width, height),
+      m_drawCommandBuffer(BufferUsage::StreamCopy),
+      m_drawChunkBuffer(BufferUsage::StreamCopy),
+      m_reachableChunkBuffer(BufferUsage::StaticDraw),
+      m_chunkOrderBuffer(BufferUsage::DynamicCopy),
+      m_chunkLevelBuffer(BufferUsage::DynamicCopy),
+      m_chunkBandBuffer(BufferUsage::DynamicCopy),
+      m_bandBuffer(BufferUsage::DynamicCopy),
+      m_visibilityBuffer(BufferUsage::DynamicCopy),
+      m_counterBuffers{Buffer(BufferUsage::StreamRead), Buffer(BufferUsage::StreamRead)} {
+    m_orderShader.init("shaders/order.comp");
+    m_cullShader.init("shaders/cull.comp");
+}
+
+bool GpuCuller::isSupported() {
+    return GLEW_ARB_indirect_parameters && GLEW_ARB_shader_draw_parameters;
+}
+
+void GpuCuller::render(const World &world, const Shader &shader, const Camera &camera,
+                       const Framebuffer &framebuffer) {
+    // at most one level of every cluster is drawn
+    size_t drawSlots = world.getChunkCount() * world.getChunkStorage().getClustersPerLevel();
+    if (drawSlots == 0)
+        return;
+
+    Buffer &counters = m_counterBuffers[m_frame % 2];
+    Buffer &previousCounters = m_counterBuffers[(m_frame + 1) % 2];
+    if (previousCounters.getSize() > 0) {
+        glGetNamedBufferSubData(previousCounters.getId(), offsetof(Counters, stats), sizeof(CullingStats), &m_stats);
+    }
+    Counters zero{};
+    counters.setData(&zero, sizeof(zero));
+    ++m_frame;
+
+    m_drawCommandBuffer.reserve(static_cast<GLsizeiptr>(drawSlots * 2 * sizeof(DrawArraysIndirectCommand)));
+    m_drawChunkBuffer.reserve(static_cast<GLsizeiptr>(drawSlots * 2 * sizeof(GLuint)));
+
+    // new clusters start out hidden and are picked up by the second pass
+    auto visibilitySize = static_cast<GLsizeiptr>(drawSlots * sizeof(GLuint));
+    if (m_visibilityBuffer.getSize() != visibilitySize) {
+        std::vector<GLuint> visibility(drawSlots, 0);
+        m_visibilityBuffer.setData(visibility);
+    }
+
+    order(world, camera);
+
+    m_cullShader.use();
+    m_cullShader.setMat4("uProjectionView", camera.getProjectionViewMatrix());
+    m_cullShader.setVec3("uCameraPosition", camera.getPosition());
+    m_cullShader.setVec2("uViewportSize", glm::vec2(m_width, m_height));
+    m_cullShader.setInt("uDrawSlots", static_cast<int>(drawSlots));
+    m_cullShader.setInt("uVerticesPerInstance", static_cast<int>(world.getChunkStorage().getVerticesPerInstance()));
+    m_cullShader.setInt("uOcclusion", m_occlusion);
+    m_cullShader.setInt("uHiZ", 1);
+    m_cullShader.setIVec2("uHiZSize", glm::ivec2(m_width, m_height));
+    m_cullShader.setInt("uHiZLevels", m_hiZBuffer.getLevels());
+
+    cull(0, world, counters);
+    draw(0, world, shader, counters);
+
+    if (!m_occlusion)
+        return;
+
+    m_hiZBuffer.build(framebuffer.getDepthTexture());
+
+    glBindTextureUnit(1, m_hiZBuffer.getTexture());
+    cull(1, world, counters);
+    glBindTextureUnit(1, 0);
+    draw(1, world, shader, counters);
+}
+
+void GpuCuller::redraw(const World &world, const Shader &shader) {
+    if (world.getChunkCount() * world.getChunkStorage().getClustersPerLevel() == 0)
+        return;
+
+    // the counters render wrote its draw counts into
+    const Buffer &counters = m_counterBuffers[(m_frame + 1) % 2];
+    draw(0, world, shader, counters);
+    if (m_occlusion)
+        draw(1, world, shader, counters);
+}
+
+void GpuCuller::readChunkLevels(std::vector<uint32_t> &levels) const {
+    levels.resize(static_cast<size_t>(m_chunkLevelBuffer.getSize()) / sizeof(uint32_t));
+    if (!levels.empty())
+        glGetNamedBufferSubData(m_chunkLevelBuffer.getId(), 0, m_chunkLevelBuffer.getSize(), levels.data());
+}
+
+void GpuCuller::order(const World &world, const Camera &camera) {
+    // chunks hidden behind solid space are left out, their clusters keep their visibility. they only
+    // change when the camera enters another chunk, most frames keep the last upload
+    if (world.getReachabilityVersion() != m_reachabilityVersion) {
+        m_reachabilityVersion = world.getReachabilityVersion();
+        m_reachableChunks.clear();
+        for (uint32_t chunk = 0; chunk < world.getChunkCount(); ++chunk) {
+            if (world.isChunkReachable(chunk))
+                m_reachableChunks.push_back(chunk);
+        }
+        m_reachableChunkBuffer.setData(m_reachableChunks);
+        m_chunkOrderBuffer.reserve(static_cast<GLsizeiptr>(m_reachableChunks.size() * sizeof(GLuint)));
+        m_chunkBandBuffer.reserve(static_cast<GLsizeiptr>(m_reachableChunks.size() * sizeof(glm::uvec2)));
+    }
+
+    // new chunks start out at level 0
+    auto levelSize = static_cast<GLsizeiptr>(world.getChunkCount() * sizeof(GLuint));
+    if (!m_levelsValid) {
+        std::vector<uint32_t> levels = world.getChunkLevels();
+        levels.resize(world.getChunkCount(), 0);
+        m_chunkLevelBuffer.setData(levels);
+        m_levelsValid = true;
+    } else if (m_chunkLevelBuffer.getSize() < levelSize) {
+        GLsizeiptr previous = m_chunkLevelBuffer.getSize();
+        m_chunkLevelBuffer.grow(levelSize);
+        glClearNamedBufferSubData(m_chunkLevelBuffer.getId(), GL_R32UI, previous, levelSize - previous,
+                                  GL_RED_INTEGER, GL_UNSIGNED_INT, nullptr);
+    }
+
+    m_bandBuffer.reserve(static_cast<GLsizeiptr>(ORDER_BANDS * sizeof(GLuint)));
+    glClearNamedBufferData(m_bandBuffer.getId(), GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, nullptr);
+
+    m_orderShader.use();
+    m_orderShader.setStorageBuffer("uReachableChunks", m_reachableChunkBuffer, 0);
+    m_orderShader.setStorageBuffer("uChunks", world.getChunkStorage().getInfoBuffer(), 1);
+    m_orderShader.setStorageBuffer("uChunkLevels", m_chunkLevelBuffer, 2);
+    m_orderShader.setStorageBuffer("uChunkBands", m_chunkBandBuffer, 3);
+    m_orderShader.setStorageBuffer("uBands", m_bandBuffer, 4);
+    m_orderShader.setStorageBuffer("uChunkOrder", m_chunkOrderBuffer, 5);
+    m_orderShader.setInt("uReachableCount", static_cast<int>(m_reachableChunks.size()));
+    m_orderShader.setVec3("uCameraPosition", camera.getPosition());
+    // half the viewport height over tan(fov / 2)
+    m_orderShader.setFloat("uFocalLength", camera.getProjectionMatrix()[1][1] * (float) m_height * 0.5f);
+    m_orderShader.setFloat("uLodPixels", world.getLodPixels());
+
+    auto groups = static_cast<GLuint>((m_reachableChunks.size() + ORDER_GROUP_SIZE - 1) / ORDER_GROUP_SIZE);
+    // bin, scan and scatter, the scan of the bands is a single workgroup
+    for (int stage = 0; stage < 3; ++stage) {
+        m_orderShader.setInt("uStage", stage);
+        m_orderShader.dispatch(stage == 1 ? 1 : groups);
+        glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+    }
+}
+
+void GpuCuller::cull(int pass, const World &world, const Buffer &counters) {
+    // binding points are shared with the draw, so they are renewed for every pass
+    const ChunkStorage &storage = world.getChunkStorage();
+    m_cullShader.use();
+    m_cullShader.setStorageBuffer("uClusters", storage.getClusterBuffer(), 0);
+    m_cullShader.setStorageBuffer("uDrawCommands", m_drawCommandBuffer, 1);
+    m_cullShader.setStorageBuffer("uDrawChunks", m_drawChunkBuffer, 2);
+    m_cullShader.setStorageBuffer("uVisibility", m_visibilityBuffer, 3);
+    m_cullShader.setStorageBuffer("uCounters", counters, 4);
+    m_cullShader.setStorageBuffer("uChunkOrder", m_chunkOrderBuffer, 5);
+    m_cullShader.setStorageBuffer("uChunks", storage.getInfoBuffer(), 6);
+    m_cullShader.setStorageBuffer("uChunkLevels", m_chunkLevelBuffer, 7);
+    m_cullShader.setInt("uPass", pass);
+    m_cullShader.dispatch(static_cast<GLuint>(m_reachableChunks.size()));
+
+    glMemoryBarrier(GL_COMMAND_BARRIER_BIT | GL_SHADER_STORAGE_BARRIER_BIT | GL_BUFFER_UPDATE_BARRIER_BIT);
+}
+
+void GpuCuller::draw(int pass, const World &world, const Shader &shader, const Buffer &counters) {
+    const ChunkStorage &storage = world.getChunkStorage();
+    size_t drawSlots = world.getChunkCount() * storage.getClustersPerLevel();
+
+    shader.use();
+    shader.setFloat("uChunkSize", CHUNK_SIZE);
+    shader.setInt("uMultiDraw", 1);
+    shader.setInt("uDrawOffset", static_cast<int>(pass * drawSlots));
+    shader.setStorageBuffer("uChunks", storage.getInfoBuffer(), 1);
+    shader.setStorageBuffer("uDrawChunks", m_drawChunkBuffer, 2);
+    shader.setStorageBuffer("uInstances", storage.getInstanceBuffer(), 4);
+    shader.setStorageBuffer("uInstanceOrders", storage.getOrderBuffer(), 5);
+
+    storage.getVertexArray().bind();
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, m_drawCommandBuffer.getId());
+    glBindBuffer(GL_PARAMETER_BUFFER_ARB, counters.getId());
+    auto commands = static_cast<GLintptr>(pass * drawSlots * sizeof(DrawArraysIndirectCommand));
+    glMultiDrawArraysIndirectCountARB(world.getInstancePrimitive(), reinterpret_cast<const void *>(commands),
+                                      static_cast<GLintptr>(pass * sizeof(GLuint)),
+                                      static_cast<GLsizei>(drawSlots), 0);
+}
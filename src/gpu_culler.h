@@ -0,0 +1,118 @@
+#pragma once
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+#include <array>
+#include <cstdint>
+#include <vector>
+
+#include "shader.h"
+#include "buffer.h"
+#include "camera.h"
+#include "framebuffer.h"
+#include "hiz_buffer.h"
+#include "world/world.h"
+
+// matches the statistics part of the uCounters block in cull.comp
+struct CullingStats {
+    uint32_t visibleClusters{0};
+    uint32_t drawnClusters{0};
+    uint32_t drawnInstances{0};
+    // clusters whose exposed faces all point away from the camera
+    uint32_t backFacingClusters{0};
+};
+
+// Culls and draws the clusters of a world entirely on the GPU. A compute shader
+// tests the bounds and exposed faces of every cluster and appends the draw
+// commands of the visible ones, which are drawn with a single multi draw call
+// whose count also comes from the GPU, so the CPU issues the same few calls
+// however many clusters there are. Another compute shader selects the level of
+// every chunk and orders them front to back by bucketing them into distance
+// bands, only the list of reachable chunks comes from the CPU and it is only
+// uploaded when the camera enters another chunk and that changes it, so the
+// CPU work of a frame doesn't grow with the number of chunks. Chunks are culled
+// in that order and the clusters of each chunk in the order of the camera's
+// octant, so the commands come out roughly front to back. Every command also picks the
+// instance order of the camera's octant and walks it backwards from the +x
+// side, so that the voxels of a cluster are front to back as well.
+//
+// With occlusion enabled the clusters that were visible last frame are drawn
+// first, their depth is reduced into a hi-z pyramid and every cluster is tested
+// against it. Clusters that turn out to be visible but were not drawn yet are
+// drawn in a second pass, the result is kept for the next frame.
+class GpuCuller {
+public:
+    GpuCuller(int width, int height);
+
+    // requires ARB_indirect_parameters and ARB_shader_draw_parameters
+    static bool isSupported();
+
+    // for a framebuffer of another size
+    void resize(int width, int height) {
+        m_width = width;
+        m_height = height;
+        m_hiZBuffer.resize(width, height);
+    }
+
+    void setOcclusion(bool enabled) {
+        m_occlusion = enabled;
+    }
+
+    // the levels of the CPU culling modes may have moved on since the last frame culled here, they
+    // are uploaded again with the reachable chunks
+    void invalidate() {
+        m_reachabilityVersion = ~uint64_t(0);
+        m_levelsValid = false;
+    }
+
+    // the levels order.comp selected in the last render
+    void readChunkLevels(std::vector<uint32_t> &levels) const;
+
+    // framebuffer must be bound
+    void render(const World &world, const Shader &shader, const Camera &camera, const Framebuffer &framebuffer);
+
+    // draws the commands of the last render again without culling, e.g. to shade after a depth prepass
+    void redraw(const World &world, const Shader &shader);
+
+    // counters of the previous frame, reading the current ones would stall
+    [[nodiscard]] const CullingStats &getStats() const {
+        return m_stats;
+    }
+
+private:
+    int m_width;
+    int m_height;
+    bool m_occlusion{true};
+    HiZBuffer m_hiZBuffer;
+    Shader m_orderShader;
+    Shader m_cullShader;
+
+    // compacted commands and the chunk index of every command, each pass writes its own half
+    Buffer m_drawCommandBuffer;
+    Buffer m_drawChunkBuffer;
+    // uploaded when World::getReachabilityVersion differs from m_reachabilityVersion
+    std::vector<uint32_t> m_reachableChunks;
+    uint64_t m_reachabilityVersion{~uint64_t(0)};
+    Buffer m_reachableChunkBuffer;
+    // written by order.comp every frame, the levels are kept for the hysteresis and start out as
+    // World::getChunkLevels
+    Buffer m_chunkOrderBuffer;
+    Buffer m_chunkLevelBuffer;
+    bool m_levelsValid{false};
+    Buffer m_chunkBandBuffer;
+    Buffer m_bandBuffer;
+    // 1 for every cluster that was visible at the end of the last frame
+    Buffer m_visibilityBuffer;
+    // draw count of each pass followed by CullingStats, one per frame in flight
+    std::array<Buffer, 2> m_counterBuffers;
+    size_t m_frame{0};
+    CullingStats m_stats;
+
+    // selects the levels and writes the reachable chunks front to back into m_chunkOrderBuffer
+    void order(const World &world, const Camera &camera);
+
+    void cull(int pass, const World &world, const Buffer &counters);
+
+    void draw(int pass, const World &world, const Shader &shader, const Buffer &counters);
+};
@@ -0,0 +1,90 @@
+
+#include "headless_context.h"
+
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+
+#include <cstring>
+#include <stdexcept>
+
+static EGLDisplay getDisplay() {
+    // prefer the surfaceless platform, it doesn't need any kind of display server
+    const char *extensions = eglQueryString(EGL_NO_DISPLAY, EGL_EXTENSIONS);
+    if (extensions && std::strstr(extensions, "EGL_MESA_platform_surfaceless")) {
+        auto getPlatformDisplay = reinterpret_cast<PFNEGLGETPLATFORMDISPLAYEXTPROC>(
+            eglGetProcAddress("eglGetPlatformDisplayEXT"));
+        if (getPlatformDisplay) {
+            EGLDisplay display = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr);
+            if (display != EGL_NO_DISPLAY)
+                return display;
+        }
+    }
+    return eglGetDisplay(EGL_DEFAULT_DISPLAY);
+}
+
+HeadlessContext::HeadlessContext() {
+    EGLDisplay display = getDisplay();
+    if (display == EGL_NO_DISPLAY || !eglInitialize(display, nullptr, nullptr)) {
+        throw std::runtime_error("HeadlessContext: failed to initialize EGL display");
+    }
+    m_display = display;
+
+    if (!eglBindAPI(EGL_OPENGL_API)) {
+        throw std::runtime_error("HeadlessContext: OpenGL API not supported by EGL");
+    }
+
+    // everything is rendered into framebuffer objects, a 1x1 pbuffer is only
+    // needed when the driver doesn't support surfaceless contexts
+    const char *extensions = eglQueryString(display, EGL_EXTENSIONS);
+    bool surfaceless = extensions && std::strstr(extensions, "EGL_KHR_surfaceless_context");
+
+    const EGLint configAttribs[] = {
+        EGL_SURFACE_TYPE, surfaceless ? 0 : EGL_PBUFFER_BIT,
+        EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+        EGL_NONE
+    };
+    EGLConfig config;
+    EGLint configCount = 0;
+    if (!eglChooseConfig(display, configAttribs, &config, 1, &configCount) || configCount == 0) {
+        throw std::runtime_error("HeadlessContext: no suitable EGL config");
+    }
+
+    if (!surfaceless) {
+        const EGLint pbufferAttribs[] = {
+            EGL_WIDTH, 1,
+            EGL_HEIGHT, 1,
+            EGL_NONE
+        };
+        m_surface = eglCreatePbufferSurface(display, config, pbufferAttribs);
+        if (m_surface == EGL_NO_SURFACE) {
+            throw std::runtime_error("HeadlessContext: failed to create pbuffer surface");
+        }
+    }
+
+    const EGLint contextAttribs[] = {
+        EGL_CONTEXT_MAJOR_VERSION, 4,
+        EGL_CONTEXT_MINOR_VERSION, 5,
+        EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+        EGL_NONE
+    };
+    m_context = eglCreateContext(display, config, EGL_NO_CONTEXT, contextAttribs);
+    if (m_context == EGL_NO_CONTEXT) {
+        throw std::runtime_error("HeadlessContext: failed to create OpenGL 4.5 context");
+    }
+
+    EGLSurface surface = m_surface ? m_surface : EGL_NO_SURFACE;
+    if (!eglMakeCurrent(display, surface, surface, m_context)) {
+        throw std::runtime_error("HeadlessContext: failed to make context current");
+    }
+}
+
+HeadlessContext::~HeadlessContext() {
+    if (!m_display)
+        return;
+    eglMakeCurrent(m_display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+    if (m_context)
+        eglDestroyContext(m_display, m_context);
+    if (m_surface)
+        eglDestroySurface(m_display, m_surface);
+    eglTerminate(m_display);
+}
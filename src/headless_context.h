@@ -0,0 +1,19 @@
+#pragma once
+
+// OpenGL 4.5 core context without a window or display, created through EGL.
+// Works on Mesa's llvmpipe so the renderer can run on machines without a GPU.
+class HeadlessContext {
+public:
+    HeadlessContext();
+
+    ~HeadlessContext();
+
+    HeadlessContext(const HeadlessContext &other) = delete;
+
+    HeadlessContext &operator=(const HeadlessContext &other) = delete;
+
+private:
+    void *m_display{nullptr};
+    void *m_surface{nullptr};
+    void *m_context{nullptr};
+};
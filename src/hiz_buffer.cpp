@@ -0,0 +1,63 @@
+
+#include "hiz_buffer.h"
+
+#include <algorithm>
+
+HiZBuffer::HiZBuffer(int width, int height) : m_width(width), m_height(height) {
+    createTexture();
+    m_shader.init("shaders/hiz.comp");
+}
+
+HiZBuffer::~HiZBuffer() {
+    glDeleteTextures(1, &m_texture);
+}
+
+void HiZBuffer::resize(int width, int height) {
+    if (width == m_width && height == m_height)
+        return;
+    glDeleteTextures(1, &m_texture);
+    m_width = width;
+    m_height = height;
+    createTexture();
+}
+
+void HiZBuffer::createTexture() {
+    m_levels = 1;
+    for (int size = std::max(m_width, m_height); size > 1; size /= 2) {
+        ++m_levels;
+    }
+
+    glCreateTextures(GL_TEXTURE_2D, 1, &m_texture);
+    glTextureStorage2D(m_texture, m_levels, GL_R32F, m_width, m_height);
+    glTextureParameteri(m_texture, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);
+    glTextureParameteri(m_texture, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+}
+
+void HiZBuffer::build(GLuint depthTexture) {
+    m_shader.use();
+    m_shader.setInt("uDepth", 1);
+    glBindTextureUnit(1, depthTexture);
+
+    int width = m_width;
+    int height = m_height;
+    for (int level = 0; level < m_levels; ++level) {
+        int sourceWidth = width;
+        int sourceHeight = height;
+        if (level > 0) {
+            width = std::max(1, width / 2);
+            height = std::max(1, height / 2);
+        }
+
+        glBindImageTexture(0, m_texture, std::max(level - 1, 0), GL_FALSE, 0, GL_READ_ONLY, GL_R32F);
+        glBindImageTexture(1, m_texture, level, GL_FALSE, 0, GL_WRITE_ONLY, GL_R32F);
+        m_shader.setInt("uLevel", level);
+        m_shader.setIVec2("uSourceSize", glm::ivec2(sourceWidth, sourceHeight));
+        m_shader.dispatch((width + 7) / 8, (height + 7) / 8);
+
+        glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+    }
+
+    glBindImageTexture(0, 0, 0, GL_FALSE, 0, GL_READ_ONLY, GL_R32F);
+    glBindImageTexture(1, 0, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_R32F);
+    glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+}
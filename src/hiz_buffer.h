@@ -0,0 +1,40 @@
+#pragma once
+
+#include <GL/glew.h>
+
+#include "shader.h"
+
+// Mip chain of the depth buffer where every texel holds the farthest depth
+// of the texels it covers, used for conservative occlusion tests.
+class HiZBuffer {
+public:
+    HiZBuffer(int width, int height);
+
+    ~HiZBuffer();
+
+    HiZBuffer(const HiZBuffer &other) = delete;
+
+    HiZBuffer &operator=(const HiZBuffer &other) = delete;
+
+    // reallocates the pyramid for a depth buffer of another size
+    void resize(int width, int height);
+
+    void build(GLuint depthTexture);
+
+    [[nodiscard]] GLuint getTexture() const {
+        return m_texture;
+    }
+
+    [[nodiscard]] int getLevels() const {
+        return m_levels;
+    }
+
+private:
+    GLuint m_texture{0};
+    int m_width;
+    int m_height;
+    int m_levels{1};
+    Shader m_shader;
+
+    void createTexture();
+};
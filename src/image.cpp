@@ -0,0 +1,19 @@
+
+#include "image.h"
+
+#include <algorithm>
+#include <fstream>
+#include <string>
+
+bool writeImage(std::string_view path, int width, int height, const std::vector<uint8_t> &pixels) {
+    std::ofstream file(std::string(path), std::ios::binary);
+    if (!file)
+        return false;
+
+    file << "P6\n" << width << " " << height << "\n255\n";
+    const size_t count = std::min(pixels.size() / 4, static_cast<size_t>(width) * height);
+    for (size_t i = 0; i < count; ++i) {
+        file.write(reinterpret_cast<const char *>(&pixels[i * 4]), 3);
+    }
+    return static_cast<bool>(file);
+}
@@ -0,0 +1,8 @@
+#pragma once
+
+#include <string_view>
+#include <vector>
+#include <cstdint>
+
+// writes tightly packed RGBA pixels (top row first) as a binary PPM, alpha is dropped
+bool writeImage(std::string_view path, int width, int height, const std::vector<uint8_t> &pixels);
@@ -3,70 +3,190 @@
 #include <GLFW/glfw3.h>
 #include <glm/glm.hpp>
 #include <iostream>
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <string>
+#include <cmath>
+#include <thread>
 
 #include "shader.h"
 #include "world/world.h"
 #include "camera.h"
 #include "player_controller.h"
 #include "material.h"
-#include "texture_array.h"
+#include "renderer.h"
+#include "image.h"
+#include "reference_tracer.h"
+#ifdef VOXEL_HEADLESS
+#include "headless_context.h"
+#endif
 
 const int SCREEN_WIDTH = 1600;
 const int SCREEN_HEIGHT = 900;
 
 const float NEAR_PLANE = 0.1f;
-const float FAR_PLANE = 1000.0f;
-
-
-int main() {
-    if (glfwInit() == GLFW_FALSE) {
-        std::cerr << "Failed to initialize GLFW\n";
-        exit(EXIT_FAILURE);
-    }
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 5);
-    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
-    glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
-    glfwWindowHint(GLFW_RESIZABLE, GL_FALSE);
-
-    GLFWwindow *window = glfwCreateWindow(SCREEN_WIDTH, SCREEN_HEIGHT, "VoxelRayTracer", nullptr, nullptr);
-    if (!window) {
-        std::cerr << "Failed to create GLFW window\n";
-        glfwTerminate();
-        exit(EXIT_FAILURE);
+const float FAR_PLANE = 4000.0f;
+
+enum class Scene {
+    Random, // one chunk of randomly placed voxels
+    Terrain // hills with caves, mostly hidden behind themselves
+};
+
+struct Options {
+    bool headless{false};
+    // renders the orbit once with every render mode and compares them
+    bool benchmark{false};
+    Scene scene{Scene::Random};
+    CullingMode culling{CullingMode::GpuOcclusion};
+    RenderMode renderMode{RenderMode::Billboards};
+    ChunkBuildMode buildMode{ChunkBuildMode::Cpu};
+    // chunks along x and z of the terrain
+    int terrainSize{4};
+    float lodPixels{2.0f};
+    bool caveCulling{true};
+    bool depthPrepass{false};
+    bool crosshair{true};
+    // of the window size in each direction, reconstructed temporally below 1
+    float renderScale{1.0f};
+    // GPU time of a frame the render scale is adjusted for, 0 keeps it fixed
+    double targetFrameTime{0.0};
+    int frames{300};
+    // median frame time in ms above which a headless run fails, 0 disables it
+    double maxFrameTime{0.0};
+    std::string output;
+    // the last view traced on the CPU, compared with the GPU frame
+    std::string referenceOutput;
+    // 0 uses one thread per core
+    unsigned referenceThreads{0};
+    // share of the pixels that may differ from the reference before the run fails
+    double referenceThreshold{0.001};
+};
+
+static Options parseOptions(int argc, char **argv) {
+    Options options;
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--headless") == 0) {
+            options.headless = true;
+        } else if (std::strcmp(argv[i], "--benchmark") == 0) {
+            options.benchmark = true;
+        } else if (std::strcmp(argv[i], "--frames") == 0 && i + 1 < argc) {
+            options.frames = std::max(1, std::atoi(argv[++i]));
+        } else if (std::strcmp(argv[i], "--max-frame-time") == 0 && i + 1 < argc) {
+            options.maxFrameTime = std::max(0.0, std::atof(argv[++i]));
+        } else if (std::strcmp(argv[i], "--terrain-size") == 0 && i + 1 < argc) {
+            options.terrainSize = std::max(1, std::atoi(argv[++i]));
+        } else if (std::strcmp(argv[i], "--cave-culling") == 0 && i + 1 < argc) {
+            ++i;
+            if (std::strcmp(argv[i], "on") == 0) {
+                options.caveCulling = true;
+            } else if (std::strcmp(argv[i], "off") == 0) {
+                options.caveCulling = false;
+            } else {
+                std::cerr << "Unknown cave culling setting: " << argv[i] << "\n";
+                exit(EXIT_FAILURE);
+            }
+        } else if (std::strcmp(argv[i], "--depth-prepass") == 0 && i + 1 < argc) {
+            ++i;
+            if (std::strcmp(argv[i], "on") == 0) {
+                options.depthPrepass = true;
+            } else if (std::strcmp(argv[i], "off") == 0) {
+                options.depthPrepass = false;
+            } else {
+                std::cerr << "Unknown depth prepass setting: " << argv[i] << "\n";
+                exit(EXIT_FAILURE);
+            }
+        } else if (std::strcmp(argv[i], "--crosshair") == 0 && i + 1 < argc) {
+            ++i;
+            if (std::strcmp(argv[i], "on") == 0) {
+                options.crosshair = true;
+            } else if (std::strcmp(argv[i], "off") == 0) {
+                options.crosshair = false;
+            } else {
+                std::cerr << "Unknown crosshair setting: " << argv[i] << "\n";
+                exit(EXIT_FAILURE);
+            }
+        } else if (std::strcmp(argv[i], "--render-scale") == 0 && i + 1 < argc) {
+            options.renderScale = (float) std::atof(argv[++i]);
+        } else if (std::strcmp(argv[i], "--target-frame-time") == 0 && i + 1 < argc) {
+            options.targetFrameTime = std::max(0.0, std::atof(argv[++i]));
+        } else if (std::strcmp(argv[i], "--lod-pixels") == 0 && i + 1 < argc) {
+            options.lodPixels = std::max(0.0f, (float) std::atof(argv[++i]));
+        } else if (std::strcmp(argv[i], "--output") == 0 && i + 1 < argc) {
+            options.output = argv[++i];
+        } else if (std::strcmp(argv[i], "--reference") == 0 && i + 1 < argc) {
+            options.referenceOutput = argv[++i];
+        } else if (std::strcmp(argv[i], "--reference-threads") == 0 && i + 1 < argc) {
+            options.referenceThreads = (unsigned) std::max(0, std::atoi(argv[++i]));
+        } else if (std::strcmp(argv[i], "--reference-threshold") == 0 && i + 1 < argc) {
+            options.referenceThreshold = std::max(0.0, std::atof(argv[++i]));
+        } else if (std::strcmp(argv[i], "--build-mode") == 0 && i + 1 < argc) {
+            ++i;
+            if (std::strcmp(argv[i], "cpu") == 0) {
+                options.buildMode = ChunkBuildMode::Cpu;
+            } else if (std::strcmp(argv[i], "gpu") == 0) {
+                options.buildMode = ChunkBuildMode::GpuCompaction;
+            } else {
+                std::cerr << "Unknown build mode: " << argv[i] << "\n";
+                exit(EXIT_FAILURE);
+            }
+        } else if (std::strcmp(argv[i], "--culling") == 0 && i + 1 < argc) {
+            ++i;
+            if (std::strcmp(argv[i], "cpu") == 0) {
+                options.culling = CullingMode::Cpu;
+            } else if (std::strcmp(argv[i], "cpu-occlusion") == 0) {
+                options.culling = CullingMode::CpuOcclusion;
+            } else if (std::strcmp(argv[i], "gpu") == 0) {
+                options.culling = CullingMode::Gpu;
+            } else if (std::strcmp(argv[i], "occlusion") == 0) {
+                options.culling = CullingMode::GpuOcclusion;
+            } else {
+                std::cerr << "Unknown culling mode: " << argv[i] << "\n";
+                exit(EXIT_FAILURE);
+            }
+        } else if (std::strcmp(argv[i], "--renderer") == 0 && i + 1 < argc) {
+            ++i;
+            if (std::strcmp(argv[i], "billboards") == 0) {
+                options.renderMode = RenderMode::Billboards;
+            } else if (std::strcmp(argv[i], "points") == 0) {
+                options.renderMode = RenderMode::PointSprites;
+            } else if (std::strcmp(argv[i], "visibility") == 0) {
+                options.renderMode = RenderMode::VisibilityBuffer;
+            } else if (std::strcmp(argv[i], "mesh") == 0) {
+                options.renderMode = RenderMode::GreedyMeshes;
+            } else if (std::strcmp(argv[i], "raymarch") == 0) {
+                options.renderMode = RenderMode::RayMarching;
+            } else {
+                std::cerr << "Unknown renderer: " << argv[i] << "\n";
+                exit(EXIT_FAILURE);
+            }
+        } else if (std::strcmp(argv[i], "--scene") == 0 && i + 1 < argc) {
+            ++i;
+            if (std::strcmp(argv[i], "random") == 0) {
+                options.scene = Scene::Random;
+            } else if (std::strcmp(argv[i], "terrain") == 0) {
+                options.scene = Scene::Terrain;
+            } else {
+                std::cerr << "Unknown scene: " << argv[i] << "\n";
+                exit(EXIT_FAILURE);
+            }
+        } else {
+            std::cerr << "Unknown option: " << argv[i] << "\n"
+                      << "Usage: " << argv[0] << " [--headless] [--frames N] [--max-frame-time MS] [--output image.ppm] [--scene random|terrain] [--terrain-size N] [--benchmark] [--renderer billboards|points|visibility|mesh|raymarch] [--culling cpu|cpu-occlusion|gpu|occlusion] [--build-mode cpu|gpu] [--lod-pixels P] [--cave-culling on|off] [--depth-prepass on|off] [--crosshair on|off] [--render-scale S] [--target-frame-time MS] [--reference image.ppm] [--reference-threads N] [--reference-threshold F]\n";
+            exit(EXIT_FAILURE);
+        }
     }
 
-    glfwMakeContextCurrent(window);
-
-    glewExperimental = GL_TRUE;
-    if (glewInit() != GLEW_OK) {
-        std::cerr << "Failed to initialize GLEW\n";
-        glfwTerminate();
+    // the reference is traced at the window size without jitter
+    if (!options.referenceOutput.empty() && (options.renderScale < 1.0f || options.targetFrameTime > 0.0)) {
+        std::cerr << "--reference can't be combined with --render-scale below 1 or --target-frame-time\n";
         exit(EXIT_FAILURE);
     }
+    return options;
+}
 
-    glEnable(GL_DEPTH_TEST);
-
-    TextureArray textureArray("textures/andesite.png",
-                              "textures/cobblestone.png",
-                              "textures/diorite.png",
-                              "textures/dirt.png",
-                              "textures/granite.png",
-                              "textures/sand.png",
-                              "textures/mudstone.png",
-                              "textures/stone.png");
-
-
-
-    //glActiveTexture(GL_TEXTURE0);
-    //screenShader.setInt("uTextures", 0);
-
-
-    Camera camera;
-    camera.setPerspective(glm::radians(60.0f), (float) SCREEN_WIDTH / (float) SCREEN_HEIGHT, NEAR_PLANE, FAR_PLANE);
-    camera.setDirection(glm::vec3(0.0f, 0.0f, 1.0f));
-
-    std::vector<Material> materials {
+static std::vector<Material> createMaterials() {
+    return {
         Material(glm::vec4(0.0f, 0.0f, 1.0f, 1.0f)),
         Material(glm::vec4(0.0f, 1.0f, 0.0f, 1.0f)),
         Material(glm::vec4(1.0f, 0.0f, 0.0f, 1.0f)),
@@ -84,34 +204,124 @@ int main() {
         Material(glm::vec4(1.0f), 6),
         Material(glm::vec4(1.0f), 7),
     };
+}
 
-    Buffer materialBuffer;
-    materialBuffer.setData(materials);
-
-    World world;
+static void createRandomWorld(World &world, size_t materialCount) {
     std::shared_ptr<Chunk> chunk1 = std::make_shared<Chunk>();
     chunk1->fill([&](glm::ivec3 pos) -> std::optional<Voxel> {
         auto r = rand() % 1000;
         if (r < 500) {
-            return Voxel(pos, rand() % materials.size());
+            return Voxel(pos, rand() % materialCount);
         }
         return {};
     });
     world.addChunk(glm::ivec3(0, 0, 0), chunk1);
+}
 
+const int TERRAIN_HEIGHT_CHUNKS = 2;
+
+static void createTerrainWorld(World &world, int size) {
+    // material indices into createMaterials
+    constexpr uint32_t dirt = 10;
+    constexpr uint32_t granite = 11;
+    constexpr uint32_t stone = 14;
+
+    for (int x = 0; x < size; ++x) {
+        for (int y = 0; y < TERRAIN_HEIGHT_CHUNKS; ++y) {
+            for (int z = 0; z < size; ++z) {
+                glm::ivec3 chunkPosition(x, y, z);
+                glm::ivec3 origin = chunkPosition * CHUNK_SIZE;
+
+                auto chunk = std::make_shared<Chunk>();
+                chunk->fill([&](glm::ivec3 pos) -> std::optional<Voxel> {
+                    glm::vec3 p = glm::vec3(origin + pos);
+                    float height = 48.0f + 20.0f * std::sin(p.x * 0.045f) * std::cos(p.z * 0.035f)
+                                   + 8.0f * std::sin((p.x + p.z) * 0.11f);
+                    if (p.y > height)
+                        return {};
+
+                    float cave = std::sin(p.x * 0.09f) * std::sin(p.y * 0.13f) * std::sin(p.z * 0.08f);
+                    if (cave > 0.35f && p.y < height - 6.0f)
+                        return {};
+
+                    if (p.y > height - 4.0f)
+                        return Voxel(pos, dirt);
+                    return Voxel(pos, p.y < 24.0f ? granite : stone);
+                });
+
+                if (chunk->getVoxelCount() > 0)
+                    world.addChunk(chunkPosition, chunk);
+            }
+        }
+    }
+}
 
-    PlayerController cameraController(camera, world, window);
+static void createWorld(World &world, const Options &options, size_t materialCount) {
+    world.setBuildMode(options.buildMode);
+    world.setLodPixels(options.lodPixels);
+    world.setCaveCulling(options.caveCulling);
+    if (options.scene == Scene::Terrain) {
+        createTerrainWorld(world, options.terrainSize);
+    } else {
+        createRandomWorld(world, materialCount);
+    }
+}
+
+static bool initGlew() {
+    glewExperimental = GL_TRUE;
+    GLenum result = glewInit();
+    // GLEW looks for a GLX display after loading the core functions,
+    // which doesn't exist for EGL contexts
+    return result == GLEW_OK || result == GLEW_ERROR_NO_GLX_DISPLAY;
+}
+
+static int runWindowed(const Options &options) {
+    if (glfwInit() == GLFW_FALSE) {
+        std::cerr << "Failed to initialize GLFW\n";
+        exit(EXIT_FAILURE);
+    }
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 5);
+    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+    glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
+    glfwWindowHint(GLFW_RESIZABLE, GL_FALSE);
+
+    GLFWwindow *window = glfwCreateWindow(SCREEN_WIDTH, SCREEN_HEIGHT, "VoxelRayTracer", nullptr, nullptr);
+    if (!window) {
+        std::cerr << "Failed to create GLFW window\n";
+        glfwTerminate();
+        exit(EXIT_FAILURE);
+    }
 
+    glfwMakeContextCurrent(window);
 
-    Shader screenShader;
-    screenShader.init("shaders/screen.vert", "shaders/screen.frag");
-    screenShader.use();
-    screenShader.setVec2("uViewportSize", glm::vec2(SCREEN_WIDTH, SCREEN_HEIGHT));
-    //screenShader.setFloat("uNearPlane", NEAR_PLANE);
-    //screenShader.setFloat("uFarPlane", FAR_PLANE);
-    screenShader.setFloat("uReach", cameraController.getReach());
-    screenShader.setBuffer("uMaterials", materialBuffer, 0);
+    if (!initGlew()) {
+        std::cerr << "Failed to initialize GLEW\n";
+        glfwTerminate();
+        exit(EXIT_FAILURE);
+    }
 
+    Camera camera;
+    camera.setPerspective(glm::radians(60.0f), (float) SCREEN_WIDTH / (float) SCREEN_HEIGHT, NEAR_PLANE, FAR_PLANE);
+    camera.setDirection(glm::vec3(0.0f, 0.0f, 1.0f));
+    if (options.scene == Scene::Terrain)
+        camera.setPosition(glm::vec3((float) (options.terrainSize * CHUNK_SIZE) * 0.5f, 80.0f, -16.0f));
+
+    std::vector<Material> materials = createMaterials();
+
+    World world;
+    createWorld(world, options, materials.size());
+
+    PlayerController cameraController(camera, world, window);
+
+    Renderer renderer(SCREEN_WIDTH, SCREEN_HEIGHT, materials);
+    renderer.setReach(cameraController.getReach());
+    renderer.setCullingMode(options.culling);
+    renderer.setRenderMode(options.renderMode);
+    renderer.setDepthPrepass(options.depthPrepass);
+    renderer.setCrosshair(options.crosshair);
+    renderer.setRenderScale(options.renderScale);
+    renderer.setTargetFrameTime(options.targetFrameTime);
 
     while (!glfwWindowShouldClose(window)) {
         static auto lastTime = glfwGetTime();
@@ -124,7 +334,33 @@ int main() {
         static double lastFpsTime = 0.0;
         frameCount++;
         if (currentTime - lastFpsTime >= 1.0) {
-            std::cout << "FPS: " << frameCount << " voxel count: " << world.getVoxelCount() << std::endl;
+            const UploadStats &uploadStats = world.getUploadScheduler().getStats();
+            std::cout << "FPS: " << frameCount << " voxel count: " << world.getVoxelCount()
+                      << " instances: " << world.getInstanceCount();
+            if (renderer.getRenderMode() == RenderMode::RayMarching) {
+                std::cout << " ray marching";
+            } else if (renderer.getRenderMode() == RenderMode::GreedyMeshes) {
+                // meshes are culled on the CPU whatever the culling mode
+                std::cout << " culled chunks: " << world.getRenderStats().culledChunks
+                          << "/" << world.getRenderStats().chunks
+                          << " mesh vertices: " << world.getMeshStats().vertices;
+            } else if (isCpuCulling(renderer.getCullingMode())) {
+                std::cout << " culled chunks: " << world.getRenderStats().culledChunks
+                          << "/" << world.getRenderStats().chunks
+                          << " occluded: " << world.getRenderStats().occludedChunks;
+            } else {
+                std::cout << " unreachable chunks: " << world.getUnreachableChunkCount();
+                const CullingStats &cullingStats = renderer.getCullingStats();
+                std::cout << " visible clusters: " << cullingStats.visibleClusters
+                          << "/" << world.getChunkCount() * CLUSTERS_PER_CHUNK
+                          << " drawn instances: " << cullingStats.drawnInstances;
+            }
+            if (renderer.getResolutionController().isEnabled()) {
+                std::cout << " render scale: " << renderer.getRenderScale()
+                          << " gpu: " << renderer.getResolutionController().getLastMilliseconds() << " ms";
+            }
+            std::cout << " uploads pending: " << uploadStats.pendingChunks
+                      << " (" << uploadStats.pendingBytes / 1024 << " KiB)" << std::endl;
             frameCount = 0;
             lastFpsTime += 1.0;
         }
@@ -140,16 +376,55 @@ int main() {
         if (glfwGetKey(window, GLFW_KEY_2) == GLFW_PRESS)
             glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
 
-        cameraController.update((float)deltaTime);
+        if (glfwGetKey(window, GLFW_KEY_3) == GLFW_PRESS)
+            world.setBuildMode(ChunkBuildMode::Cpu);
+
+        if (glfwGetKey(window, GLFW_KEY_4) == GLFW_PRESS)
+            world.setBuildMode(ChunkBuildMode::GpuCompaction);
+
+        if (glfwGetKey(window, GLFW_KEY_5) == GLFW_PRESS)
+            renderer.setCullingMode(CullingMode::Cpu);
+
+        if (glfwGetKey(window, GLFW_KEY_6) == GLFW_PRESS)
+            renderer.setCullingMode(CullingMode::Gpu);
+
+        if (glfwGetKey(window, GLFW_KEY_7) == GLFW_PRESS)
+            renderer.setCullingMode(CullingMode::GpuOcclusion);
+
+        if (glfwGetKey(window, GLFW_KEY_0) == GLFW_PRESS)
+            renderer.setCullingMode(CullingMode::CpuOcclusion);
+
+        if (glfwGetKey(window, GLFW_KEY_F1) == GLFW_PRESS)
+            renderer.setRenderMode(RenderMode::Billboards);
+
+        if (glfwGetKey(window, GLFW_KEY_F2) == GLFW_PRESS)
+            renderer.setRenderMode(RenderMode::RayMarching);
+
+        if (glfwGetKey(window, GLFW_KEY_F3) == GLFW_PRESS)
+            renderer.setRenderMode(RenderMode::GreedyMeshes);
+
+        if (glfwGetKey(window, GLFW_KEY_F4) == GLFW_PRESS)
+            renderer.setRenderMode(RenderMode::PointSprites);
+
+        if (glfwGetKey(window, GLFW_KEY_F5) == GLFW_PRESS)
+            renderer.setRenderMode(RenderMode::VisibilityBuffer);
+
+        if (glfwGetKey(window, GLFW_KEY_F6) == GLFW_PRESS)
+            renderer.setDepthPrepass(true);
 
-        glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        if (glfwGetKey(window, GLFW_KEY_F7) == GLFW_PRESS)
+            renderer.setDepthPrepass(false);
 
-        screenShader.setMat4("uProjectionView", camera.getProjectionViewMatrix());
-        screenShader.setMat4("uInvProjectionView", camera.getInverseProjectionViewMatrix());
-        screenShader.setVec3("uCameraPosition", camera.getPosition());
+        if (glfwGetKey(window, GLFW_KEY_8) == GLFW_PRESS)
+            world.setCaveCulling(true);
 
-        world.render(screenShader);
+        if (glfwGetKey(window, GLFW_KEY_9) == GLFW_PRESS)
+            world.setCaveCulling(false);
+
+        cameraController.update((float)deltaTime);
+
+        renderer.render(world, camera);
+        renderer.present();
 
         glfwSwapBuffers(window);
     }
@@ -157,3 +432,274 @@ int main() {
     glfwTerminate();
     return 0;
 }
+
+#ifdef VOXEL_HEADLESS
+// orbits around the scene so every frame sees a different view, returns the frame times in ms
+static std::vector<double> renderOrbit(Renderer &renderer, World &world, Camera &camera, const Options &options) {
+    bool terrain = options.scene == Scene::Terrain;
+    const float terrainExtent = (float) (options.terrainSize * CHUNK_SIZE);
+    const glm::vec3 center = terrain ? glm::vec3(terrainExtent * 0.5f, 48.0f, terrainExtent * 0.5f)
+                                     : glm::vec3(CHUNK_SIZE * 0.5f);
+    const float radius = terrain ? terrainExtent * 0.6f : 90.0f;
+    const float height = terrain ? 24.0f : 40.0f;
+    std::vector<double> frameTimes;
+    frameTimes.reserve(options.frames);
+    for (int frame = 0; frame < options.frames; ++frame) {
+        float angle = glm::radians(360.0f) * (float) frame / (float) options.frames;
+        glm::vec3 position = center + glm::vec3(std::cos(angle) * radius, height, std::sin(angle) * radius);
+        camera.setPosition(position);
+        camera.setDirection(glm::normalize(center - position));
+
+        auto start = std::chrono::steady_clock::now();
+        renderer.render(world, camera);
+        glFinish();
+        frameTimes.push_back(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+    }
+    return frameTimes;
+}
+
+// returns the median
+static double printFrameTimes(const std::vector<double> &frameTimes) {
+    std::vector<double> sorted = frameTimes;
+    std::sort(sorted.begin(), sorted.end());
+    double total = 0.0;
+    for (double time: frameTimes)
+        total += time;
+    std::cout << "frames: " << frameTimes.size()
+              << " avg: " << total / (double) frameTimes.size() << " ms"
+              << " median: " << sorted[sorted.size() / 2] << " ms"
+              << " p95: " << sorted[sorted.size() * 95 / 100] << " ms"
+              << " max: " << sorted.back() << " ms" << std::endl;
+    return sorted[sorted.size() / 2];
+}
+
+// the scale changes and a histogram of the GPU frame times of the dynamic resolution
+static void printResolutionChanges(const ResolutionController &controller) {
+    std::cout << "target: " << controller.getTarget() << " ms resolution changes: " << controller.getChanges().size()
+              << std::endl;
+    for (const ResolutionChange &change: controller.getChanges()) {
+        std::cout << "  frame " << change.frame << ": scale " << change.scale << " after " << change.milliseconds
+                  << " ms" << std::endl;
+    }
+    const auto &histogram = controller.getHistogram();
+    for (size_t bucket = 0; bucket < histogram.size(); ++bucket) {
+        if (histogram[bucket] == 0)
+            continue;
+        std::cout << "  " << bucket;
+        if (bucket + 1 < histogram.size())
+            std::cout << "-" << bucket + 1 << " ms: ";
+        else
+            std::cout << "+ ms: ";
+        std::cout << histogram[bucket] << std::endl;
+    }
+}
+
+// channel differences up to this are rounding, e.g. of the texture coordinates at texel edges
+const int REFERENCE_TOLERANCE = 2;
+
+// traces the last view on the CPU, writes it and counts the pixels that differ from the GPU frame,
+// false if more than the threshold do
+static bool renderReference(const Renderer &renderer, const World &world, const Camera &camera,
+                            const std::vector<Material> &materials, const Options &options) {
+    if (renderer.getRenderWidth() != SCREEN_WIDTH || renderer.getRenderHeight() != SCREEN_HEIGHT) {
+        std::cerr << "The reference needs a frame rendered at the window size without jitter\n";
+        return false;
+    }
+
+    ReferenceTracer tracer(materials);
+    tracer.setThreadCount(options.referenceThreads);
+    tracer.setCrosshair(options.crosshair);
+    std::vector<uint8_t> reference;
+    double milliseconds = tracer.render(world, camera, SCREEN_WIDTH, SCREEN_HEIGHT, reference);
+
+    std::vector<uint8_t> pixels;
+    renderer.getFramebuffer().readPixels(pixels);
+    size_t differing = 0;
+    int maxDifference = 0;
+    for (size_t i = 0; i < pixels.size(); i += 4) {
+        int difference = 0;
+        for (size_t channel = 0; channel < 3; ++channel)
+            difference = std::max(difference, std::abs(pixels[i + channel] - reference[i + channel]));
+        maxDifference = std::max(maxDifference, difference);
+        if (difference > REFERENCE_TOLERANCE)
+            ++differing;
+    }
+    std::cout << "reference: " << milliseconds << " ms with " << tracer.getThreadCount() << " threads"
+              << " differing pixels: " << differing << "/" << pixels.size() / 4
+              << " max difference: " << maxDifference << std::endl;
+
+    if (!writeImage(options.referenceOutput, SCREEN_WIDTH, SCREEN_HEIGHT, reference)) {
+        std::cerr << "Failed to write " << options.referenceOutput << "\n";
+        return false;
+    }
+
+    auto allowed = static_cast<size_t>(options.referenceThreshold * (double) (pixels.size() / 4));
+    if (differing > allowed) {
+        std::cerr << "More than " << allowed << " pixels differ from the reference\n";
+        return false;
+    }
+    return true;
+}
+
+// the same orbit with every render mode, with the geometry each of them uploads, and the CPU reference
+// of the last view with more and more threads
+static void benchmark(Renderer &renderer, World &world, Camera &camera, const std::vector<Material> &materials,
+                      const Options &options) {
+    const std::pair<RenderMode, const char *> modes[] = {
+        {RenderMode::Billboards, "billboards"},
+        {RenderMode::PointSprites, "point sprites"},
+        {RenderMode::VisibilityBuffer, "visibility buffer"},
+        {RenderMode::GreedyMeshes, "greedy meshes"},
+        {RenderMode::RayMarching, "ray marching"}
+    };
+    for (auto &mode: modes) {
+        renderer.setRenderMode(mode.first);
+        std::vector<double> frameTimes = renderOrbit(renderer, world, camera, options);
+
+        std::cout << mode.second << ": ";
+        if (mode.first == RenderMode::Billboards || mode.first == RenderMode::PointSprites
+            || mode.first == RenderMode::VisibilityBuffer) {
+            // one billboard per exposed voxel of level 0, the quad itself is shared by all of them
+            std::cout << "instances: " << world.getInstanceCount()
+                      << " upload: " << world.getInstanceCount() * sizeof(Voxel) / 1024 << " KiB";
+        } else if (mode.first == RenderMode::GreedyMeshes) {
+            const MeshStats &meshStats = world.getMeshStats();
+            std::cout << "vertices: " << meshStats.vertices << " indices: " << meshStats.indices
+                      << " upload: " << meshStats.uploadBytes / 1024 << " KiB"
+                      << " build: " << meshStats.buildMilliseconds << " ms";
+        } else {
+            std::cout << "upload: " << world.getChunkCount() * VoxelVolume::GRID_WORDS * sizeof(uint32_t) / 1024 << " KiB";
+        }
+        std::cout << "\n  ";
+        printFrameTimes(frameTimes);
+    }
+
+    ReferenceTracer tracer(materials);
+    std::vector<uint8_t> pixels;
+    unsigned cores = std::max(1u, std::thread::hardware_concurrency());
+    std::cout << "reference tracer:" << std::endl;
+    for (unsigned threads = 1;; threads = std::min(threads * 2, cores)) {
+        tracer.setThreadCount(threads);
+        double milliseconds = tracer.render(world, camera, SCREEN_WIDTH, SCREEN_HEIGHT, pixels);
+        std::cout << "  threads: " << threads << " time: " << milliseconds << " ms ("
+                  << (double) (SCREEN_WIDTH * SCREEN_HEIGHT) / milliseconds / 1000.0 << " Mrays/s)" << std::endl;
+        if (threads == cores)
+            break;
+    }
+}
+
+static int runHeadless(const Options &options) {
+    try {
+        HeadlessContext context;
+
+        if (!initGlew()) {
+            std::cerr << "Failed to initialize GLEW\n";
+            return EXIT_FAILURE;
+        }
+
+        std::cout << "Renderer: " << glGetString(GL_RENDERER) << std::endl;
+
+        Camera camera;
+        camera.setPerspective(glm::radians(60.0f), (float) SCREEN_WIDTH / (float) SCREEN_HEIGHT, NEAR_PLANE, FAR_PLANE);
+
+        std::vector<Material> materials = createMaterials();
+
+        World world;
+        createWorld(world, options, materials.size());
+
+        Renderer renderer(SCREEN_WIDTH, SCREEN_HEIGHT, materials);
+        renderer.setCullingMode(options.culling);
+        renderer.setRenderMode(options.renderMode);
+        renderer.setDepthPrepass(options.depthPrepass);
+        renderer.setCrosshair(options.crosshair);
+        renderer.setRenderScale(options.renderScale);
+        renderer.setTargetFrameTime(options.targetFrameTime);
+
+        if (options.benchmark) {
+            benchmark(renderer, world, camera, materials, options);
+            return 0;
+        }
+
+        std::vector<double> frameTimes = renderOrbit(renderer, world, camera, options);
+        std::cout << "voxel count: " << world.getVoxelCount() << " instances: " << world.getInstanceCount();
+        if (renderer.getRenderMode() == RenderMode::RayMarching) {
+            std::cout << " ray marching" << std::endl;
+        } else if (renderer.getRenderMode() == RenderMode::GreedyMeshes) {
+            // meshes are culled on the CPU whatever the culling mode
+            const MeshStats &meshStats = world.getMeshStats();
+            std::cout << " culled chunks: " << world.getRenderStats().culledChunks
+                      << "/" << world.getRenderStats().chunks
+                      << " occluded: " << world.getRenderStats().occludedChunks
+                      << " mesh vertices: " << meshStats.vertices
+                      << " indices: " << meshStats.indices << std::endl;
+        } else if (isCpuCulling(renderer.getCullingMode())) {
+            std::cout << " culled chunks: " << world.getRenderStats().culledChunks
+                      << "/" << world.getRenderStats().chunks
+                      << " occluded: " << world.getRenderStats().occludedChunks
+                      << " occluders: " << world.getRenderStats().occluders << std::endl;
+        } else {
+            const CullingStats &cullingStats = renderer.getCullingStats();
+            std::cout << " unreachable chunks: " << world.getUnreachableChunkCount()
+                      << " visible clusters: " << cullingStats.visibleClusters
+                      << "/" << world.getChunkCount() * CLUSTERS_PER_CHUNK
+                      << " back facing: " << cullingStats.backFacingClusters
+                      << " drawn clusters: " << cullingStats.drawnClusters
+                      << " drawn instances: " << cullingStats.drawnInstances << std::endl;
+        }
+        double medianFrameTime = printFrameTimes(frameTimes);
+        // ray marching doesn't order the chunks
+        const ChunkOrderStats &orderStats = world.getChunkOrderStats();
+        if (orderStats.frames > 0) {
+            // the walk only runs when the camera enters another chunk, which the orbit does far more often
+            // than walking around
+            double walk = orderStats.walks > 0 ? orderStats.walkMilliseconds / (double) orderStats.walks : 0.0;
+            std::cout << "chunk order: " << (orderStats.milliseconds - orderStats.walkMilliseconds) / (double) orderStats.frames
+                      << " ms per frame for " << world.getChunkCount() << " chunks, changed in " << orderStats.changes
+                      << "/" << orderStats.frames << " frames, walked in " << orderStats.walks << " frames taking "
+                      << walk << " ms each" << std::endl;
+        }
+        if (renderer.getResolutionController().isEnabled())
+            printResolutionChanges(renderer.getResolutionController());
+
+        if (!options.output.empty()) {
+            std::vector<uint8_t> pixels;
+            renderer.getFramebuffer().readPixels(pixels);
+            if (!writeImage(options.output, SCREEN_WIDTH, SCREEN_HEIGHT, pixels)) {
+                std::cerr << "Failed to write " << options.output << "\n";
+                return EXIT_FAILURE;
+            }
+        }
+
+        if (!options.referenceOutput.empty()) {
+            // the tracer draws every chunk at the level of the last frame
+            renderer.syncChunkLevels(world);
+            if (!renderReference(renderer, world, camera, materials, options))
+                return EXIT_FAILURE;
+        }
+
+        if (options.maxFrameTime > 0.0 && medianFrameTime > options.maxFrameTime) {
+            std::cerr << "Median frame time " << medianFrameTime << " ms is above " << options.maxFrameTime << " ms\n";
+            return EXIT_FAILURE;
+        }
+    } catch (const std::exception &e) {
+        std::cerr << e.what() << "\n";
+        return EXIT_FAILURE;
+    }
+    return 0;
+}
+#endif
+
+int main(int argc, char **argv) {
+    Options options = parseOptions(argc, argv);
+
+    if (options.headless) {
+#ifdef VOXEL_HEADLESS
+        return runHeadless(options);
+#else
+        std::cerr << "Built without headless support (EGL not found)\n";
+        return EXIT_FAILURE;
+#endif
+    }
+
+    return runWindowed(options);
+}
@@ -1,8 +1,21 @@
 #pragma once
 
+#include <array>
 #include <cstdint>
 #include <glm/vec4.hpp>
 
+// layers of the texture array, Material::texture is an index into it
+inline constexpr std::array<const char *, 8> TEXTURE_PATHS = {
+    "textures/andesite.png",
+    "textures/cobblestone.png",
+    "textures/diorite.png",
+    "textures/dirt.png",
+    "textures/granite.png",
+    "textures/sand.png",
+    "textures/mudstone.png",
+    "textures/stone.png"
+};
+
 struct Material {
     glm::vec4 color;
     uint32_t texture;
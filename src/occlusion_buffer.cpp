@@ -0,0 +1,171 @@
+
+#include "occlusion_buffer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <utility>
+
+#if defined(__SSE__) || defined(_M_X64)
+#include <xmmintrin.h>
+#define OCCLUSION_SSE
+#endif
+
+OcclusionBuffer::OcclusionBuffer(int width, int height)
+        : m_width((width + 3) & ~3), m_height(height) {
+    m_depth.assign(static_cast<size_t>(m_width) * m_height, 1.0f);
+}
+
+void OcclusionBuffer::clear(const glm::mat4 &projectionView) {
+    m_projectionView = projectionView;
+    std::fill(m_depth.begin(), m_depth.end(), 1.0f);
+}
+
+bool OcclusionBuffer::projectBox(const glm::vec3 &min, const glm::vec3 &max, glm::vec3 (&corners)[8]) const {
+    for (int i = 0; i < 8; ++i) {
+        glm::vec4 clip = m_projectionView * glm::vec4(i & 1 ? max.x : min.x,
+                                                      i & 2 ? max.y : min.y,
+                                                      i & 4 ? max.z : min.z, 1.0f);
+        if (clip.w <= 0.0f || clip.z < -clip.w)
+            return false;
+        glm::vec3 ndc = glm::vec3(clip) / clip.w;
+        corners[i] = glm::vec3((ndc.x * 0.5f + 0.5f) * (float) m_width,
+                               (ndc.y * 0.5f + 0.5f) * (float) m_height,
+                               ndc.z);
+    }
+    return true;
+}
+
+void OcclusionBuffer::rasterizeBox(const glm::vec3 &min, const glm::vec3 &max) {
+    glm::vec3 corners[8];
+    if (!projectBox(min, max, corners))
+        return;
+
+    // corners of the -x, +x, -y, +y, -z and +z faces in order around the face
+    static constexpr int faces[6][4] = {
+        {0, 2, 6, 4}, {1, 3, 7, 5},
+        {0, 1, 5, 4}, {2, 3, 7, 6},
+        {0, 1, 3, 2}, {4, 5, 7, 6}
+    };
+    for (int face = 0; face < 6; ++face) {
+        // the camera is at the origin, the back faces are hidden behind the front faces
+        int axis = face / 2;
+        bool front = face & 1 ? max[axis] < 0.0f : min[axis] > 0.0f;
+        if (!front)
+            continue;
+        const int *corner = faces[face];
+        rasterizeTriangle(corners[corner[0]], corners[corner[1]], corners[corner[2]]);
+        rasterizeTriangle(corners[corner[0]], corners[corner[2]], corners[corner[3]]);
+    }
+}
+
+void OcclusionBuffer::rasterizeTriangle(glm::vec3 v0, glm::vec3 v1, glm::vec3 v2) {
+    float area = (v1.x - v0.x) * (v2.y - v0.y) - (v1.y - v0.y) * (v2.x - v0.x);
+    if (area == 0.0f)
+        return;
+    if (area < 0.0f) {
+        std::swap(v1, v2);
+        area = -area;
+    }
+
+    // pixels whose centers lie in the triangle's bounds
+    int x0 = std::max(0, (int) std::ceil(std::min({v0.x, v1.x, v2.x}) - 0.5f));
+    int x1 = std::min(m_width - 1, (int) std::floor(std::max({v0.x, v1.x, v2.x}) - 0.5f));
+    int y0 = std::max(0, (int) std::ceil(std::min({v0.y, v1.y, v2.y}) - 0.5f));
+    int y1 = std::min(m_height - 1, (int) std::floor(std::max({v0.y, v1.y, v2.y}) - 0.5f));
+    if (x0 > x1 || y0 > y1)
+        return;
+    x0 &= ~3;
+
+    // edge i is opposite of vertex i and a * x + b * y + c >= 0 inside, divided by the area it is
+    // the barycentric weight of vertex i
+    glm::vec3 a(v1.y - v2.y, v2.y - v0.y, v0.y - v1.y);
+    glm::vec3 b(v2.x - v1.x, v0.x - v2.x, v1.x - v0.x);
+    glm::vec3 c(-a.x * v1.x - b.x * v1.y, -a.y * v2.x - b.y * v2.y, -a.z * v0.x - b.z * v0.y);
+
+    // depth is linear in screen space, the farthest depth within the pixel is stored
+    glm::vec3 z(v0.z, v1.z, v2.z);
+    float dzdx = glm::dot(a, z) / area;
+    float dzdy = glm::dot(b, z) / area;
+    float z0 = glm::dot(c, z) / area + 0.5f * (std::abs(dzdx) + std::abs(dzdy));
+
+#ifdef OCCLUSION_SSE
+    const __m128 offsets = _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f);
+    const __m128 zero = _mm_setzero_ps();
+    for (int y = y0; y <= y1; ++y) {
+        float py = (float) y + 0.5f;
+        __m128 row0 = _mm_set1_ps(b.x * py + c.x);
+        __m128 row1 = _mm_set1_ps(b.y * py + c.y);
+        __m128 row2 = _mm_set1_ps(b.z * py + c.z);
+        __m128 rowZ = _mm_set1_ps(dzdy * py + z0);
+        float *depth = &m_depth[static_cast<size_t>(y) * m_width];
+        for (int x = x0; x <= x1; x += 4) {
+            __m128 px = _mm_add_ps(_mm_set1_ps((float) x), offsets);
+            __m128 inside = _mm_and_ps(
+                _mm_and_ps(_mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(a.x), px), row0), zero),
+                           _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(a.y), px), row1), zero)),
+                _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(a.z), px), row2), zero));
+            if (_mm_movemask_ps(inside) == 0)
+                continue;
+            __m128 current = _mm_loadu_ps(depth + x);
+            __m128 nearest = _mm_min_ps(current, _mm_add_ps(_mm_mul_ps(_mm_set1_ps(dzdx), px), rowZ));
+            _mm_storeu_ps(depth + x, _mm_or_ps(_mm_and_ps(inside, nearest), _mm_andnot_ps(inside, current)));
+        }
+    }
+#else
+    for (int y = y0; y <= y1; ++y) {
+        float py = (float) y + 0.5f;
+        float *depth = &m_depth[static_cast<size_t>(y) * m_width];
+        for (int x = x0; x <= x1; ++x) {
+            float px = (float) x + 0.5f;
+            if (a.x * px + b.x * py + c.x >= 0.0f &&
+                a.y * px + b.y * py + c.y >= 0.0f &&
+                a.z * px + b.z * py + c.z >= 0.0f) {
+                depth[x] = std::min(depth[x], dzdx * px + dzdy * py + z0);
+            }
+        }
+    }
+#endif
+}
+
+bool OcclusionBuffer::isOccluded(const glm::vec3 &min, const glm::vec3 &max) const {
+    glm::vec3 corners[8];
+    if (!projectBox(min, max, corners))
+        return false;
+
+    glm::vec3 low = corners[0];
+    glm::vec3 high = corners[0];
+    for (auto &corner: corners) {
+        low = glm::min(low, corner);
+        high = glm::max(high, corner);
+    }
+
+    // every pixel the box touches and a ring around them
+    int x0 = std::max(0, (int) std::floor(low.x) - 1);
+    int x1 = std::min(m_width - 1, (int) std::floor(high.x) + 1);
+    int y0 = std::max(0, (int) std::floor(low.y) - 1);
+    int y1 = std::min(m_height - 1, (int) std::floor(high.y) + 1);
+    if (x0 > x1 || y0 > y1)
+        return false;
+    x0 &= ~3;
+
+    // testing a few more pixels to the right of the box only makes it more conservative
+#ifdef OCCLUSION_SSE
+    const __m128 nearest = _mm_set1_ps(low.z);
+    for (int y = y0; y <= y1; ++y) {
+        const float *depth = &m_depth[static_cast<size_t>(y) * m_width];
+        for (int x = x0; x <= x1; x += 4) {
+            if (_mm_movemask_ps(_mm_cmplt_ps(_mm_loadu_ps(depth + x), nearest)) != 0xF)
+                return false;
+        }
+    }
+#else
+    for (int y = y0; y <= y1; ++y) {
+        const float *depth = &m_depth[static_cast<size_t>(y) * m_width];
+        for (int x = x0; x <= x1; ++x) {
+            if (depth[x] >= low.z)
+                return false;
+        }
+    }
+#endif
+    return true;
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <vector>
+
+// Low resolution depth buffer that occluders are rasterized into on the CPU, so that boxes
+// behind them can be culled before anything is submitted and without reading back from the
+// GPU. Coverage is sampled at pixel centers like on the GPU, depths are rounded away from the
+// camera and tested boxes are grown by a pixel, which keeps the error below a buffer pixel.
+class OcclusionBuffer {
+public:
+    OcclusionBuffer(int width, int height);
+
+    // empties the buffer, boxes are relative to the camera and projected with projectionView
+    void clear(const glm::mat4 &projectionView);
+
+    // draws the faces of the box that point towards the camera, boxes crossing the near plane are skipped
+    void rasterizeBox(const glm::vec3 &min, const glm::vec3 &max);
+
+    // true if every pixel the box may cover already holds something in front of it
+    [[nodiscard]] bool isOccluded(const glm::vec3 &min, const glm::vec3 &max) const;
+
+    [[nodiscard]] int getWidth() const {
+        return m_width;
+    }
+
+    [[nodiscard]] int getHeight() const {
+        return m_height;
+    }
+
+private:
+    // a multiple of 4 so that rows can be processed four pixels at a time
+    int m_width;
+    int m_height;
+    // normalized device depth, 1 where nothing was drawn
+    std::vector<float> m_depth;
+    glm::mat4 m_projectionView{1.0f};
+
+    // screen position in pixels and depth of the 8 corners, false if one is in front of the near plane
+    bool projectBox(const glm::vec3 &min, const glm::vec3 &max, glm::vec3 (&corners)[8]) const;
+
+    void rasterizeTriangle(glm::vec3 v0, glm::vec3 v1, glm::vec3 v2);
+};
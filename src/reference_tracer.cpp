@@ -0,0 +1,365 @@
+
+#include "reference_tracer.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <stdexcept>
+#include <string>
+#include <thread>
+
+#include "stb_image.h"
+
+#if defined(__SSE__) || defined(_M_X64)
+#include <xmmintrin.h>
+#define TRACER_SSE
+#endif
+
+struct ReferenceTracer::Scene {
+    // chunk index of every chunk position in [mapMin, mapMin + mapSize) ordered by x, y then z,
+    // -1 where there is no chunk
+    glm::ivec3 mapMin{0};
+    glm::ivec3 mapSize{0};
+    std::vector<int32_t> chunkMap;
+    std::vector<const uint32_t *> grids;
+    std::vector<int> levels;
+    std::vector<glm::vec3> origins;
+
+    glm::vec3 cameraPosition{0.0f};
+    glm::mat4 invProjectionView{1.0f};
+    int width{0};
+    int height{0};
+};
+
+struct ReferenceTracer::Hit {
+    float distance{0.0f};
+    glm::vec3 normal{0.0f};
+    glm::vec2 texCoord{0.0f};
+    uint32_t material{EMPTY_VOXEL};
+};
+
+static float maxComponent(const glm::vec3 &a) {
+    return std::max(a.x, std::max(a.y, a.z));
+}
+
+static float minComponent(const glm::vec3 &a) {
+    return std::min(a.x, std::min(a.y, a.z));
+}
+
+static int floorDiv(int a, int b) {
+    return a >= 0 ? a / b : -((-a + b - 1) / b);
+}
+
+static uint8_t toUnorm8(float value) {
+    return static_cast<uint8_t>(std::lround(std::clamp(value, 0.0f, 1.0f) * 255.0f));
+}
+
+// intersectBox of the AXIS_ALIGNED variant of screen.frag for a box around center, relative to the camera,
+// that the ray may start in. direction is the unnormalized one of the shader and the distance is measured in it
+static bool intersectBox(const glm::vec3 &center, float radius, const glm::vec3 &direction,
+                         float &distance, glm::vec3 &normal, glm::vec2 &texCoord) {
+    glm::vec3 origin = -center;
+    glm::vec3 boxRadius(radius);
+    glm::vec3 invRadius = 1.0f / boxRadius;
+
+    float winding = maxComponent(glm::abs(origin) * invRadius) < 1.0f ? -1.0f : 1.0f;
+    glm::vec3 sgn = -glm::sign(direction);
+    glm::vec3 distanceToPlane = (boxRadius * winding * sgn - origin) * (1.0f / direction);
+
+    auto test = [&](int u, int v, int w) {
+        return distanceToPlane[u] >= 0.0f
+               && std::abs(origin[v] + direction[v] * distanceToPlane[u]) < boxRadius[v]
+               && std::abs(origin[w] + direction[w] * distanceToPlane[u]) < boxRadius[w];
+    };
+    bool testX = test(0, 1, 2);
+    bool testY = test(1, 2, 0);
+    bool testZ = test(2, 0, 1);
+    sgn = testX ? glm::vec3(sgn.x, 0.0f, 0.0f)
+                : (testY ? glm::vec3(0.0f, sgn.y, 0.0f) : glm::vec3(0.0f, 0.0f, testZ ? sgn.z : 0.0f));
+    distance = sgn.x != 0.0f ? distanceToPlane.x : (sgn.y != 0.0f ? distanceToPlane.y : distanceToPlane.z);
+
+    auto faceCoord = [&](int u, int v) {
+        return glm::vec2((origin[u] + direction[u] * distance + boxRadius[u]) * invRadius[u] * 0.5f,
+                         (origin[v] + direction[v] * distance + boxRadius[v]) * invRadius[v] * 0.5f);
+    };
+    if (sgn.x > 0.0f)
+        texCoord = faceCoord(2, 1) * glm::vec2(-1.0f, 1.0f) + glm::vec2(1.0f, 0.0f);
+    else if (sgn.x < 0.0f)
+        texCoord = faceCoord(2, 1);
+    else if (sgn.y > 0.0f)
+        texCoord = faceCoord(0, 2) * glm::vec2(-1.0f, 1.0f) + glm::vec2(1.0f, 0.0f);
+    else if (sgn.y < 0.0f)
+        texCoord = faceCoord(0, 2);
+    else if (sgn.z > 0.0f)
+        texCoord = faceCoord(0, 1);
+    else
+        texCoord = faceCoord(0, 1) * glm::vec2(-1.0f, 1.0f) + glm::vec2(1.0f, 0.0f);
+
+    normal = sgn;
+    return sgn.x != 0.0f || sgn.y != 0.0f || sgn.z != 0.0f;
+}
+
+ReferenceTracer::ReferenceTracer(const std::vector<Material> &materials) : m_materials(materials) {
+    // bottom row first, like the texture array
+    stbi_set_flip_vertically_on_load(true);
+    for (const char *path: TEXTURE_PATHS) {
+        int width = 0;
+        int height = 0;
+        int channels = 0;
+        unsigned char *data = stbi_load(path, &width, &height, &channels, 4);
+        if (!data)
+            throw std::runtime_error(std::string("ReferenceTracer: failed to load texture ") + path);
+        if (m_texels.empty()) {
+            m_textureWidth = width;
+            m_textureHeight = height;
+        } else if (width != m_textureWidth || height != m_textureHeight) {
+            stbi_image_free(data);
+            throw std::runtime_error("ReferenceTracer: all textures must be the same size");
+        }
+        m_texels.insert(m_texels.end(), data, data + static_cast<size_t>(width) * height * 4);
+        stbi_image_free(data);
+    }
+}
+
+unsigned ReferenceTracer::getThreadCount() const {
+    if (m_threadCount > 0)
+        return m_threadCount;
+    return std::max(1u, std::thread::hardware_concurrency());
+}
+
+double ReferenceTracer::render(const World &world, const Camera &camera, int width, int height,
+                               std::vector<uint8_t> &pixels) const {
+    auto start = std::chrono::steady_clock::now();
+
+    Scene scene;
+    scene.cameraPosition = camera.getPosition();
+    scene.invProjectionView = camera.getInverseProjectionViewMatrix();
+    scene.width = width;
+    scene.height = height;
+
+    // empty chunks are left out of the map so that rays skip them at once
+    size_t chunkCount = world.getChunkCount();
+    const std::vector<uint32_t> &chunkLevels = world.getChunkLevels();
+    scene.mapMin = world.getChunkMin();
+    scene.mapSize = chunkCount > 0 ? world.getChunkMax() - world.getChunkMin() + 1 : glm::ivec3(0);
+    scene.chunkMap.assign(static_cast<size_t>(scene.mapSize.x) * scene.mapSize.y * scene.mapSize.z, -1);
+    scene.grids.resize(chunkCount);
+    scene.levels.resize(chunkCount);
+    scene.origins.resize(chunkCount);
+    for (size_t i = 0; i < chunkCount; ++i) {
+        const Chunk &chunk = world.getChunk(i);
+        glm::ivec3 position = world.getChunkPositions()[i];
+        scene.grids[i] = chunk.getGrid().data();
+        scene.levels[i] = i < chunkLevels.size() ? static_cast<int>(chunkLevels[i]) : 0;
+        scene.origins[i] = glm::vec3(position * CHUNK_SIZE);
+        if (chunk.getVoxelCount() == 0)
+            continue;
+        glm::ivec3 local = position - scene.mapMin;
+        scene.chunkMap[(static_cast<size_t>(local.x) * scene.mapSize.y + local.y) * scene.mapSize.z + local.z] =
+            static_cast<int32_t>(i);
+    }
+
+    pixels.assign(static_cast<size_t>(width) * height * 4, 0);
+    int tilesX = (width + TILE_SIZE - 1) / TILE_SIZE;
+    int tilesY = (height + TILE_SIZE - 1) / TILE_SIZE;
+    int tileCount = tilesX * tilesY;
+
+    // tiles are handed out one at a time so that threads that got cheap ones take more
+    std::atomic<int> nextTile{0};
+    auto worker = [&]() {
+        for (int tile = nextTile++; tile < tileCount; tile = nextTile++)
+            traceTile(scene, tile % tilesX, tile / tilesX, pixels);
+    };
+    std::vector<std::thread> threads;
+    for (unsigned i = 1; i < getThreadCount(); ++i)
+        threads.emplace_back(worker);
+    worker();
+    for (auto &thread: threads)
+        thread.join();
+
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+void ReferenceTracer::traceTile(const Scene &scene, int tileX, int tileY, std::vector<uint8_t> &pixels) const {
+    constexpr int TILE_PIXELS = TILE_SIZE * TILE_SIZE;
+    // the directions of screenToWorldSpace in screen.frag and their normalized versions for the
+    // traversal, generated for whole tiles even where they reach past the image
+    alignas(16) float rayX[TILE_PIXELS];
+    alignas(16) float rayY[TILE_PIXELS];
+    alignas(16) float rayZ[TILE_PIXELS];
+    alignas(16) float directionX[TILE_PIXELS];
+    alignas(16) float directionY[TILE_PIXELS];
+    alignas(16) float directionZ[TILE_PIXELS];
+
+    const glm::mat4 &invProjectionView = scene.invProjectionView;
+    // gl_FragCoord counts rows from the bottom
+    int x0 = tileX * TILE_SIZE;
+    int y0 = scene.height - (tileY + 1) * TILE_SIZE;
+#ifdef TRACER_SSE
+    const __m128 offsets = _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f);
+    const __m128 scaleX = _mm_set1_ps(2.0f / (float) scene.width);
+    const __m128 one = _mm_set1_ps(1.0f);
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 epsilon = _mm_set1_ps(1e-7f);
+    for (int y = 0; y < TILE_SIZE; ++y) {
+        float ndcY = ((float) (y0 + y) + 0.5f) * 2.0f / (float) scene.height - 1.0f;
+        glm::vec3 row = glm::vec3(invProjectionView[1]) * ndcY - glm::vec3(invProjectionView[2])
+                        + glm::vec3(invProjectionView[3]);
+        for (int x = 0; x < TILE_SIZE; x += 4) {
+            int i = y * TILE_SIZE + x;
+            __m128 ndcX = _mm_sub_ps(_mm_mul_ps(_mm_add_ps(_mm_set1_ps((float) (x0 + x)), offsets), scaleX), one);
+            __m128 dx = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(invProjectionView[0].x), ndcX), _mm_set1_ps(row.x));
+            __m128 dy = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(invProjectionView[0].y), ndcX), _mm_set1_ps(row.y));
+            __m128 dz = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(invProjectionView[0].z), ndcX), _mm_set1_ps(row.z));
+            _mm_store_ps(rayX + i, dx);
+            _mm_store_ps(rayY + i, dy);
+            _mm_store_ps(rayZ + i, dz);
+
+            __m128 length = _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)),
+                                                   _mm_mul_ps(dz, dz)));
+            dx = _mm_div_ps(dx, length);
+            dy = _mm_div_ps(dy, length);
+            dz = _mm_div_ps(dz, length);
+            // keeps the reciprocals finite along the axes
+            __m128 zeroX = _mm_cmpeq_ps(dx, zero);
+            __m128 zeroY = _mm_cmpeq_ps(dy, zero);
+            __m128 zeroZ = _mm_cmpeq_ps(dz, zero);
+            _mm_store_ps(directionX + i, _mm_or_ps(_mm_andnot_ps(zeroX, dx), _mm_and_ps(zeroX, epsilon)));
+            _mm_store_ps(directionY + i, _mm_or_ps(_mm_andnot_ps(zeroY, dy), _mm_and_ps(zeroY, epsilon)));
+            _mm_store_ps(directionZ + i, _mm_or_ps(_mm_andnot_ps(zeroZ, dz), _mm_and_ps(zeroZ, epsilon)));
+        }
+    }
+#else
+    for (int y = 0; y < TILE_SIZE; ++y) {
+        float ndcY = ((float) (y0 + y) + 0.5f) * 2.0f / (float) scene.height - 1.0f;
+        glm::vec3 row = glm::vec3(invProjectionView[1]) * ndcY - glm::vec3(invProjectionView[2])
+                        + glm::vec3(invProjectionView[3]);
+        for (int x = 0; x < TILE_SIZE; ++x) {
+            int i = y * TILE_SIZE + x;
+            float ndcX = ((float) (x0 + x) + 0.5f) * 2.0f / (float) scene.width - 1.0f;
+            glm::vec3 ray = glm::vec3(invProjectionView[0]) * ndcX + row;
+            rayX[i] = ray.x;
+            rayY[i] = ray.y;
+            rayZ[i] = ray.z;
+
+            // keeps the reciprocals finite along the axes
+            glm::vec3 direction = glm::normalize(ray);
+            directionX[i] = direction.x != 0.0f ? direction.x : 1e-7f;
+            directionY[i] = direction.y != 0.0f ? direction.y : 1e-7f;
+            directionZ[i] = direction.z != 0.0f ? direction.z : 1e-7f;
+        }
+    }
+#endif
+
+    const glm::vec3 light = glm::normalize(glm::vec3(0.3f, 1.0f, -0.5f));
+    const glm::vec2 viewportSize((float) scene.width, (float) scene.height);
+    const glm::vec2 aspect(viewportSize.x / viewportSize.y, 1.0f);
+    for (int y = 0; y < TILE_SIZE; ++y) {
+        int fragY = y0 + y;
+        if (fragY < 0)
+            continue;
+        for (int x = 0; x < TILE_SIZE && x0 + x < scene.width; ++x) {
+            int i = y * TILE_SIZE + x;
+            glm::vec3 color(0.0f);
+            Hit hit;
+            if (traceRay(scene, {directionX[i], directionY[i], directionZ[i]}, {rayX[i], rayY[i], rayZ[i]}, hit)) {
+                const Material &material = m_materials[hit.material];
+                color = glm::vec3(material.color) * (glm::vec3(0.1f) + glm::max(glm::dot(hit.normal, light), 0.0f));
+                if (material.texture != UINT32_MAX)
+                    color *= sampleTexture(material.texture, hit.texCoord);
+
+                // the crosshair of screen.frag
+                glm::vec2 fragCoord((float) (x0 + x) + 0.5f, (float) fragY + 0.5f);
+                if (m_crosshair && glm::length(fragCoord / viewportSize * aspect - aspect * 0.5f) < 0.005f) {
+                    glm::vec3 crosshair = hit.distance < m_reach ? glm::vec3(0.0f, 1.0f, 0.2f)
+                                                                 : glm::vec3(1.0f, 0.0f, 0.2f);
+                    color = glm::mix(crosshair, color, 0.5f);
+                }
+            }
+
+            uint8_t *pixel = &pixels[(static_cast<size_t>(scene.height - 1 - fragY) * scene.width + x0 + x) * 4];
+            pixel[0] = toUnorm8(color.x);
+            pixel[1] = toUnorm8(color.y);
+            pixel[2] = toUnorm8(color.z);
+            pixel[3] = 255;
+        }
+    }
+}
+
+bool ReferenceTracer::traceRay(const Scene &scene, const glm::vec3 &direction, const glm::vec3 &rayDirection,
+                               Hit &hit) {
+    glm::vec3 origin = scene.cameraPosition;
+    glm::vec3 invDirection = 1.0f / direction;
+
+    glm::ivec3 volumeMin = scene.mapMin * CHUNK_SIZE;
+    glm::ivec3 volumeMax = (scene.mapMin + scene.mapSize) * CHUNK_SIZE;
+    glm::vec3 tNear = (glm::vec3(volumeMin) - origin) * invDirection;
+    glm::vec3 tFar = (glm::vec3(volumeMax) - origin) * invDirection;
+    float t = std::max(maxComponent(glm::min(tNear, tFar)), 0.0f);
+    if (t >= minComponent(glm::max(tNear, tFar)))
+        return false;
+
+    glm::ivec3 voxel = glm::clamp(glm::ivec3(glm::floor(origin + direction * t)), volumeMin, volumeMax - 1);
+    for (;;) {
+        if (glm::any(glm::lessThan(voxel, volumeMin)) || glm::any(glm::greaterThanEqual(voxel, volumeMax)))
+            return false;
+
+        // the largest empty cell around the voxel, a whole chunk if it is missing and else the coarsest
+        // empty level down to the one the chunk is drawn at
+        glm::ivec3 chunkPosition(floorDiv(voxel.x, CHUNK_SIZE), floorDiv(voxel.y, CHUNK_SIZE),
+                                 floorDiv(voxel.z, CHUNK_SIZE));
+        glm::ivec3 mapPosition = chunkPosition - scene.mapMin;
+        int32_t index = scene.chunkMap[(static_cast<size_t>(mapPosition.x) * scene.mapSize.y + mapPosition.y)
+                                       * scene.mapSize.z + mapPosition.z];
+        int size = CHUNK_SIZE;
+        if (index >= 0) {
+            glm::ivec3 local = voxel - chunkPosition * CHUNK_SIZE;
+            int chunkLevel = scene.levels[index];
+            uint32_t material = EMPTY_VOXEL;
+            for (int level = LOD_LEVELS - 1; level >= chunkLevel; --level) {
+                glm::ivec3 cell = local / (1 << level);
+                int cells = CHUNK_SIZE >> level;
+                material = scene.grids[index][getLevelOffset(level) + (cell.x * cells + cell.y) * cells + cell.z];
+                if (material == EMPTY_VOXEL) {
+                    size = 1 << level;
+                    break;
+                }
+            }
+            if (material != EMPTY_VOXEL) {
+                // the billboard of the cell, positioned like in screen.vert
+                float scale = (float) (1 << chunkLevel);
+                glm::vec3 center = (glm::vec3(local / (1 << chunkLevel)) + 0.5f) * scale + scene.origins[index]
+                                   - scene.cameraPosition;
+                if (intersectBox(center, 0.5f * scale, rayDirection, hit.distance, hit.normal, hit.texCoord)) {
+                    hit.material = material;
+                    return true;
+                }
+                // grazed at an edge, the next cell along the ray has the hit
+                size = 1 << chunkLevel;
+            }
+        }
+
+        // step to the cell the ray enters when it leaves this one
+        glm::vec3 cellMin(voxel.x & ~(size - 1), voxel.y & ~(size - 1), voxel.z & ~(size - 1));
+        glm::vec3 cellMax = cellMin + (float) size;
+        glm::vec3 exit(direction.x > 0.0f ? cellMax.x : cellMin.x, direction.y > 0.0f ? cellMax.y : cellMin.y,
+                       direction.z > 0.0f ? cellMax.z : cellMin.z);
+        glm::vec3 tExit = (exit - origin) * invDirection;
+        t = minComponent(tExit);
+        int axis = tExit.x == t ? 0 : (tExit.y == t ? 1 : 2);
+        glm::ivec3 next = glm::clamp(glm::ivec3(glm::floor(origin + direction * t)), glm::ivec3(cellMin),
+                                     glm::ivec3(cellMax) - 1);
+        next[axis] = direction[axis] > 0.0f ? (int) cellMax[axis] : (int) cellMin[axis] - 1;
+        voxel = next;
+    }
+}
+
+glm::vec3 ReferenceTracer::sampleTexture(uint32_t layer, const glm::vec2 &texCoord) const {
+    float u = texCoord.x - std::floor(texCoord.x);
+    float v = texCoord.y - std::floor(texCoord.y);
+    int x = std::min((int) (u * (float) m_textureWidth), m_textureWidth - 1);
+    int y = std::min((int) (v * (float) m_textureHeight), m_textureHeight - 1);
+    const uint8_t *texel = &m_texels[((static_cast<size_t>(layer) * m_textureHeight + y) * m_textureWidth + x) * 4];
+    return glm::vec3(texel[0], texel[1], texel[2]) / 255.0f;
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <vector>
+
+#include "camera.h"
+#include "material.h"
+#include "world/world.h"
+
+// Renders a World on the CPU without any GL calls, as a reference for the GPU
+// renderers and as a benchmark of its own. Every ray walks the chunk grids
+// like raymarch.frag to find the first solid cell at its chunk's level of
+// detail, which is then intersected, lit and textured exactly like the
+// billboard of that cell in screen.frag. The image is split into tiles that
+// worker threads take one after the other.
+class ReferenceTracer {
+public:
+    // loads the layers of TEXTURE_PATHS that the materials refer to
+    explicit ReferenceTracer(const std::vector<Material> &materials);
+
+    void setReach(float reach) {
+        m_reach = reach;
+    }
+
+    void setCrosshair(bool enabled) {
+        m_crosshair = enabled;
+    }
+
+    // 0 uses one thread per core
+    void setThreadCount(unsigned count) {
+        m_threadCount = count;
+    }
+
+    [[nodiscard]] unsigned getThreadCount() const;
+
+    // traces camera's view of the world into tightly packed RGBA pixels, top row first like
+    // Framebuffer::readPixels. chunks use World::getChunkLevels, which the GPU culling modes only
+    // fill in on Renderer::syncChunkLevels, or level 0 before there was one. returns the time it took in ms
+    double render(const World &world, const Camera &camera, int width, int height,
+                  std::vector<uint8_t> &pixels) const;
+
+private:
+    // pixels along each side of the tiles the threads take
+    static constexpr int TILE_SIZE = 32;
+
+    std::vector<Material> m_materials;
+    // RGBA8 layers of m_textureWidth * m_textureHeight texels, bottom row first like in GL
+    std::vector<uint8_t> m_texels;
+    int m_textureWidth{0};
+    int m_textureHeight{0};
+    float m_reach{0.0f};
+    bool m_crosshair{true};
+    unsigned m_threadCount{0};
+
+    struct Scene;
+    struct Hit;
+
+    void traceTile(const Scene &scene, int tileX, int tileY, std::vector<uint8_t> &pixels) const;
+
+    // the first cell the ray hits, direction is normalized without zero components and rayDirection
+    // is the unnormalized direction of screen.frag that the hit distance is measured in
+    static bool traceRay(const Scene &scene, const glm::vec3 &direction, const glm::vec3 &rayDirection, Hit &hit);
+
+    // sampled with GL_NEAREST and GL_REPEAT
+    [[nodiscard]] glm::vec3 sampleTexture(uint32_t layer, const glm::vec2 &texCoord) const;
+};
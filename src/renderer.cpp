@@ -0,0 +1,338 @@
+
+#include "renderer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <tuple>
+
+// element index of the low discrepancy sequence in the given base, in [0, 1)
+static float halton(int index, int base) {
+    float result = 0.0f;
+    float fraction = 1.0f;
+    for (; index > 0; index /= base) {
+        fraction /= (float) base;
+        result += fraction * (float) (index % base);
+    }
+    return result;
+}
+
+Renderer::Renderer(int width, int height, const std::vector<Material> &materials)
+    : m_width(width), m_height(height),
+      m_renderWidth(width), m_renderHeight(height),
+      m_framebuffer(width, height),
+      m_visibilityFramebuffer(width, height, GL_RG32UI),
+      m_gpuCuller(width, height),
+      m_history{Framebuffer(width, height, GL_RGBA16F), Framebuffer(width, height, GL_RGBA16F)},
+      m_textureArray(std::apply([](auto... paths) { return TextureArray(paths...); }, TEXTURE_PATHS)) {
+    m_materialBuffer.setData(materials);
+    setCullingMode(CullingMode::GpuOcclusion);
+
+    for (const Material &material: materials)
+        m_texturedMaterials.push_back(material.texture != UINT32_MAX);
+
+    GLfloat pointSizeRange[2];
+    glGetFloatv(GL_POINT_SIZE_RANGE, pointSizeRange);
+    m_maxPointSize = pointSizeRange[1];
+
+    // variants are compiled on first use, after the render scale and reach may have changed
+    m_screenVariants.setSetup([this](const Shader &shader) { setupVariant(shader); });
+    m_meshVariants.setSetup([this](const Shader &shader) { setupVariant(shader); });
+    m_rayMarchVariants.setSetup([this](const Shader &shader) { setupVariant(shader); });
+    m_resolveVariants.setSetup([this](const Shader &shader) {
+        setupVariant(shader);
+        shader.setInt("uVoxelIds", 1);
+        shader.setInt("uDepth", 2);
+    });
+
+    m_visibilityShader.init("shaders/screen.vert", "shaders/visibility.frag");
+    m_visibilityShader.use();
+    m_visibilityShader.setBuffer("uMaterials", m_materialBuffer, 0);
+
+    m_temporalShader.init("shaders/raymarch.vert", "shaders/temporal.frag");
+    m_temporalShader.use();
+    m_temporalShader.setVec2("uOutputSize", glm::vec2(m_width, m_height));
+    m_temporalShader.setInt("uColor", 1);
+    m_temporalShader.setInt("uDepth", 2);
+    m_temporalShader.setInt("uHistory", 3);
+    for (const Framebuffer &history: m_history) {
+        glTextureParameteri(history.getColorTexture(), GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTextureParameteri(history.getColorTexture(), GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTextureParameteri(history.getColorTexture(), GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTextureParameteri(history.getColorTexture(), GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    }
+
+    setRenderScale(1.0f);
+}
+
+void Renderer::setRenderScale(float scale) {
+    m_renderScale = glm::clamp(scale, 0.25f, 1.0f);
+    m_renderWidth = std::max(1, (int) std::lround((float) m_width * m_renderScale));
+    m_renderHeight = std::max(1, (int) std::lround((float) m_height * m_renderScale));
+
+    m_framebuffer.resize(m_renderWidth, m_renderHeight);
+    m_visibilityFramebuffer.resize(m_renderWidth, m_renderHeight);
+    m_gpuCuller.resize(m_renderWidth, m_renderHeight);
+    m_nextRenderScale = m_renderScale;
+
+    glm::vec2 viewportSize(m_renderWidth, m_renderHeight);
+    m_visibilityShader.use();
+    m_visibilityShader.setVec2("uViewportSize", viewportSize);
+    // only the crosshair and the point sprites read the viewport size, some variants have neither
+    for (const ShaderVariants *variants: {&m_screenVariants, &m_resolveVariants, &m_meshVariants,
+                                          &m_rayMarchVariants}) {
+        variants->forEach([&](const Shader &shader) {
+            if (shader.hasUniform("uViewportSize"))
+                shader.setVec2("uViewportSize", viewportSize);
+        });
+    }
+    m_temporalShader.use();
+    m_temporalShader.setVec2("uRenderSize", viewportSize);
+}
+
+void Renderer::setReach(float reach) {
+    m_reach = reach;
+    for (const ShaderVariants *variants: {&m_screenVariants, &m_resolveVariants, &m_meshVariants,
+                                          &m_rayMarchVariants}) {
+        variants->forEach([&](const Shader &shader) {
+            if (shader.hasUniform("uReach"))
+                shader.setFloat("uReach", reach);
+        });
+    }
+}
+
+void Renderer::setupVariant(const Shader &shader) const {
+    shader.setBuffer("uMaterials", m_materialBuffer, 0);
+    if (shader.hasUniform("uMaxPointSize"))
+        shader.setFloat("uMaxPointSize", m_maxPointSize);
+    if (shader.hasUniform("uViewportSize"))
+        shader.setVec2("uViewportSize", glm::vec2(m_renderWidth, m_renderHeight));
+    if (shader.hasUniform("uReach"))
+        shader.setFloat("uReach", m_reach);
+}
+
+void Renderer::setCullingMode(CullingMode mode) {
+    if (!isCpuCulling(mode) && !GpuCuller::isSupported())
+        mode = CullingMode::Cpu;
+    m_cullingMode = mode;
+    m_gpuCuller.setOcclusion(mode == CullingMode::GpuOcclusion);
+}
+
+void Renderer::syncChunkLevels(World &world) const {
+    if (!m_gpuOrdered)
+        return;
+    std::vector<uint32_t> levels;
+    m_gpuCuller.readChunkLevels(levels);
+    world.setChunkLevels(levels);
+}
+
+void Renderer::render(World &world, const Camera &camera) {
+    bool dynamicResolution = m_resolutionController.isEnabled();
+    if (dynamicResolution) {
+        if (m_nextRenderScale != m_renderScale)
+            setRenderScale(m_nextRenderScale);
+        m_resolutionController.beginFrame();
+    }
+
+    if (isUpscaling()) {
+        // every 16 frames cover each internal pixel evenly
+        int sample = static_cast<int>(m_frame % 16) + 1;
+        glm::vec2 jitter(halton(sample, 2) - 0.5f, halton(sample, 3) - 0.5f);
+        Camera jittered = camera;
+        jittered.setJitter(jitter * 2.0f / glm::vec2(m_renderWidth, m_renderHeight));
+        renderScene(world, jittered);
+        upscale(camera, jitter);
+    } else {
+        renderScene(world, camera);
+        m_historyValid = false;
+    }
+
+    if (dynamicResolution)
+        m_nextRenderScale = m_resolutionController.endFrame(m_renderScale);
+}
+
+void Renderer::renderScene(World &world, const Camera &camera) {
+    world.flush(camera);
+
+    m_framebuffer.bind();
+    glEnable(GL_DEPTH_TEST);
+    glEnable(GL_PROGRAM_POINT_SIZE);
+
+    glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+    glBindTextureUnit(0, m_textureArray.getId());
+
+    if (m_renderMode == RenderMode::RayMarching) {
+        rayMarch(world, camera);
+        return;
+    }
+
+    // the GPU culler orders the chunks and selects their levels itself, the meshes are always culled
+    // on the CPU. whichever side takes over starts from the levels of the other
+    bool gpuOrdered = m_renderMode != RenderMode::GreedyMeshes && !isCpuCulling(m_cullingMode);
+    if (gpuOrdered) {
+        if (!m_gpuOrdered)
+            m_gpuCuller.invalidate();
+        world.updateReachability(camera);
+    } else {
+        syncChunkLevels(world);
+        // half the viewport height over tan(fov / 2)
+        world.updateChunkOrder(camera, camera.getProjectionMatrix()[1][1] * (float) m_renderHeight * 0.5f);
+    }
+    m_gpuOrdered = gpuOrdered;
+
+    if (m_renderMode == RenderMode::GreedyMeshes) {
+        world.updateMeshes();
+        world.cull(camera, m_cullingMode == CullingMode::CpuOcclusion);
+        const Shader &shader = m_meshVariants.get(getShadingKey(true));
+        const Shader &untextured = m_meshVariants.get(getShadingKey(false));
+        for (const Shader *variant: {&shader, &untextured}) {
+            variant->use();
+            variant->setMat4("uProjectionView", camera.getProjectionViewMatrix());
+            variant->setVec3("uCameraPosition", camera.getPosition());
+            variant->setBuffer("uMaterials", m_materialBuffer, 0);
+        }
+        world.renderMeshes(shader, untextured, m_texturedMaterials);
+        return;
+    }
+
+    // the visibility pass draws the same billboards into its own framebuffer, which also provides
+    // the depth for the hi-z pyramid
+    bool visibility = m_renderMode == RenderMode::VisibilityBuffer;
+    // the billboards are never rotated
+    uint32_t key = ShaderVariants::AXIS_ALIGNED;
+    const Shader &shader = visibility ? m_visibilityShader : m_screenVariants.get(key | getShadingKey(true));
+    const Shader &untextured = visibility ? m_visibilityShader : m_screenVariants.get(key | getShadingKey(false));
+    const Framebuffer &framebuffer = visibility ? m_visibilityFramebuffer : m_framebuffer;
+    if (visibility) {
+        const GLuint noVoxel[4] = {~0u, ~0u, ~0u, ~0u};
+        const GLfloat farDepth = 1.0f;
+        m_visibilityFramebuffer.bind();
+        glClearNamedFramebufferuiv(m_visibilityFramebuffer.getId(), GL_COLOR, 0, noVoxel);
+        glClearNamedFramebufferfv(m_visibilityFramebuffer.getId(), GL_DEPTH, 0, &farDepth);
+    }
+
+    world.setPointSprites(m_renderMode == RenderMode::PointSprites);
+    if (isCpuCulling(m_cullingMode))
+        world.cull(camera, m_cullingMode == CullingMode::CpuOcclusion);
+
+    // the visibility buffer already shades every pixel once
+    bool prepass = m_depthPrepass && !visibility;
+    if (prepass) {
+        glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+        // has to agree with the shading pass on AXIS_ALIGNED for the depths to be equal
+        const Shader &depthOnly = m_screenVariants.get(key | ShaderVariants::DEPTH_ONLY);
+        drawInstances(world, depthOnly, depthOnly, camera, framebuffer, true);
+        glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+        glDepthFunc(GL_EQUAL);
+        glDepthMask(GL_FALSE);
+    }
+
+    drawInstances(world, shader, untextured, camera, framebuffer, !prepass);
+
+    if (prepass) {
+        glDepthFunc(GL_LESS);
+        glDepthMask(GL_TRUE);
+    }
+
+    if (visibility)
+        resolve(world, camera);
+}
+
+void Renderer::drawInstances(World &world, const Shader &shader, const Shader &untextured, const Camera &camera,
+                             const Framebuffer &framebuffer, bool cull) {
+    for (const Shader *variant: {&shader, &untextured}) {
+        variant->use();
+        variant->setMat4("uProjectionView", camera.getProjectionViewMatrix());
+        variant->setMat4("uInvProjectionView", camera.getInverseProjectionViewMatrix());
+        variant->setVec3("uCameraPosition", camera.getPosition());
+        variant->setInt("uPointSprites", m_renderMode == RenderMode::PointSprites);
+    }
+
+    if (isCpuCulling(m_cullingMode)) {
+        world.render(shader, untextured, m_texturedMaterials);
+        return;
+    }
+    const Shader &variant = world.hasAnyMaterial(m_texturedMaterials) ? shader : untextured;
+    if (cull) {
+        m_gpuCuller.render(world, variant, camera, framebuffer);
+    } else {
+        m_gpuCuller.redraw(world, variant);
+    }
+}
+
+void Renderer::rayMarch(World &world, const Camera &camera) {
+    const VoxelVolume &volume = world.updateVolume();
+
+    // a single pass over the whole world, so textures are only left out if no chunk has any
+    const Shader &shader = m_rayMarchVariants.get(getShadingKey(world.hasAnyMaterial(m_texturedMaterials)));
+    shader.use();
+    shader.setMat4("uProjectionView", camera.getProjectionViewMatrix());
+    shader.setMat4("uInvProjectionView", camera.getInverseProjectionViewMatrix());
+    shader.setVec3("uCameraPosition", camera.getPosition());
+    shader.setIVec3("uVolumeMin", volume.getMin());
+    shader.setIVec3("uVolumeSize", volume.getSize());
+    shader.setInt("uGridWords", static_cast<int>(VoxelVolume::GRID_WORDS));
+    shader.setBuffer("uMaterials", m_materialBuffer, 0);
+    shader.setStorageBuffer("uGrids", volume.getGridBuffer(), 1);
+    shader.setStorageBuffer("uChunkMap", volume.getChunkMapBuffer(), 2);
+
+    m_emptyVertexArray.bind();
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+}
+
+void Renderer::resolve(const World &world, const Camera &camera) {
+    m_framebuffer.bind();
+    // every pixel is written once with the depth of the visibility pass
+    glDepthFunc(GL_ALWAYS);
+
+    const Shader &shader = m_resolveVariants.get(getShadingKey(world.hasAnyMaterial(m_texturedMaterials)));
+    shader.use();
+    shader.setMat4("uInvProjectionView", camera.getInverseProjectionViewMatrix());
+    shader.setVec3("uCameraPosition", camera.getPosition());
+    shader.setBuffer("uMaterials", m_materialBuffer, 0);
+    shader.setStorageBuffer("uChunks", world.getChunkStorage().getInfoBuffer(), 1);
+    glBindTextureUnit(1, m_visibilityFramebuffer.getColorTexture());
+    glBindTextureUnit(2, m_visibilityFramebuffer.getDepthTexture());
+
+    m_emptyVertexArray.bind();
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+
+    glBindTextureUnit(1, 0);
+    glBindTextureUnit(2, 0);
+    glDepthFunc(GL_LESS);
+}
+
+void Renderer::upscale(const Camera &camera, const glm::vec2 &jitter) {
+    const Framebuffer &history = m_history[m_historyIndex];
+    m_historyIndex = 1 - m_historyIndex;
+    m_history[m_historyIndex].bind();
+    glDisable(GL_DEPTH_TEST);
+
+    m_temporalShader.use();
+    m_temporalShader.setVec2("uJitter", jitter);
+    m_temporalShader.setInt("uHistoryValid", m_historyValid);
+    m_temporalShader.setMat4("uInvProjectionView", camera.getInverseProjectionViewMatrix());
+    m_temporalShader.setMat4("uPreviousProjectionView", m_previousProjectionView);
+    m_temporalShader.setVec3("uCameraOffset", camera.getPosition() - m_previousCameraPosition);
+    glBindTextureUnit(1, m_framebuffer.getColorTexture());
+    glBindTextureUnit(2, m_framebuffer.getDepthTexture());
+    glBindTextureUnit(3, history.getColorTexture());
+
+    m_emptyVertexArray.bind();
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+
+    glBindTextureUnit(1, 0);
+    glBindTextureUnit(2, 0);
+    glBindTextureUnit(3, 0);
+
+    m_previousProjectionView = camera.getProjectionViewMatrix();
+    m_previousCameraPosition = camera.getPosition();
+    m_historyValid = true;
+    ++m_frame;
+}
+
+void Renderer::present() const {
+    glBlitNamedFramebuffer(getFramebuffer().getId(), 0, 0, 0, m_width, m_height, 0, 0, m_width, m_height,
+                           GL_COLOR_BUFFER_BIT, GL_NEAREST);
+}
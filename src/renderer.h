@@ -0,0 +1,195 @@
+#pragma once
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+#include <array>
+#include <vector>
+
+#include "shader.h"
+#include "shader_variants.h"
+#include "buffer.h"
+#include "camera.h"
+#include "material.h"
+#include "texture_array.h"
+#include "framebuffer.h"
+#include "gpu_culler.h"
+#include "vertex_array.h"
+#include "resolution_controller.h"
+#include "world/world.h"
+
+enum class CullingMode {
+    Cpu, // frustum culling on the CPU, one draw call per chunk
+    CpuOcclusion, // like Cpu with solid clusters rasterized into a software depth buffer on top
+    Gpu, // frustum culling in a compute shader, one multi draw call
+    GpuOcclusion // like Gpu with hierarchical-Z occlusion culling on top
+};
+
+enum class RenderMode {
+    Billboards, // a camera facing quad per exposed voxel intersected with its box, scales with voxels
+    PointSprites, // like Billboards with one point per voxel, a sixth of the vertex work
+    VisibilityBuffer, // like Billboards writing only voxel ids, shaded once per pixel in a full screen pass
+    GreedyMeshes, // coplanar faces of the same material merged into quads, culled like CullingMode::Cpu
+    RayMarching // rays marched through the grids of all chunks in one full screen pass, scales with pixels
+};
+
+inline bool isCpuCulling(CullingMode mode) {
+    return mode == CullingMode::Cpu || mode == CullingMode::CpuOcclusion;
+}
+
+class Renderer {
+public:
+    Renderer(int width, int height, const std::vector<Material> &materials);
+
+    void setReach(float reach);
+
+    // the crosshair in the middle of the view, compiled out of the shaders while disabled
+    void setCrosshair(bool enabled) {
+        m_crosshair = enabled;
+    }
+
+    // falls back to CullingMode::Cpu when GPU driven rendering isn't supported
+    void setCullingMode(CullingMode mode);
+
+    void setRenderMode(RenderMode mode) {
+        m_renderMode = mode;
+    }
+
+    [[nodiscard]] RenderMode getRenderMode() const {
+        return m_renderMode;
+    }
+
+    // draws the billboards and point sprites twice, first only their depth and then the shading with
+    // GL_EQUAL, so that only the visible fragments are shaded
+    void setDepthPrepass(bool enabled) {
+        m_depthPrepass = enabled;
+    }
+
+    [[nodiscard]] bool getDepthPrepass() const {
+        return m_depthPrepass;
+    }
+
+    // renders at scale times the window size in each direction, below 1 every frame is jittered
+    // by a sub-pixel offset and reconstructed at the window size together with the previous ones
+    void setRenderScale(float scale);
+
+    [[nodiscard]] float getRenderScale() const {
+        return m_renderScale;
+    }
+
+    // adjusts the render scale every frame to keep the GPU time of a frame below milliseconds, 0 keeps
+    // the scale fixed
+    void setTargetFrameTime(double milliseconds) {
+        m_resolutionController.setTarget(milliseconds);
+    }
+
+    // GPU frame times and scale changes while a target frame time is set
+    [[nodiscard]] const ResolutionController &getResolutionController() const {
+        return m_resolutionController;
+    }
+
+    [[nodiscard]] int getRenderWidth() const {
+        return m_renderWidth;
+    }
+
+    [[nodiscard]] int getRenderHeight() const {
+        return m_renderHeight;
+    }
+
+    // renders into the offscreen framebuffer, present copies it to the window
+    void render(World &world, const Camera &camera);
+
+    void present() const;
+
+    // the window sized result of the last render
+    [[nodiscard]] const Framebuffer &getFramebuffer() const {
+        return isUpscaling() ? m_history[m_historyIndex] : m_framebuffer;
+    }
+
+    [[nodiscard]] CullingMode getCullingMode() const {
+        return m_cullingMode;
+    }
+
+    [[nodiscard]] const CullingStats &getCullingStats() const {
+        return m_gpuCuller.getStats();
+    }
+
+    // the GPU culling modes select the levels on the GPU, this reads them back into the world,
+    // e.g. for the reference tracer. stalls until the last frame is done
+    void syncChunkLevels(World &world) const;
+
+private:
+    int m_width;
+    int m_height;
+    float m_renderScale{1.0f};
+    int m_renderWidth;
+    int m_renderHeight;
+
+    // the depth buffer has to be sampleable for the hi-z pyramid
+    Framebuffer m_framebuffer;
+    // voxel ids and depth of the nearest hit of every pixel, see visibility.frag
+    Framebuffer m_visibilityFramebuffer;
+    GpuCuller m_gpuCuller;
+    CullingMode m_cullingMode{CullingMode::Cpu};
+    // whether the last frame ordered the chunks and selected their levels on the GPU
+    bool m_gpuOrdered{false};
+    RenderMode m_renderMode{RenderMode::Billboards};
+    bool m_depthPrepass{false};
+
+    // reconstructed window sized frames, the last one is read while the next one is written
+    std::array<Framebuffer, 2> m_history;
+    size_t m_historyIndex{0};
+    bool m_historyValid{false};
+    size_t m_frame{0};
+    glm::mat4 m_previousProjectionView{1.0f};
+    glm::vec3 m_previousCameraPosition{0.0f};
+
+    ResolutionController m_resolutionController;
+    // picked after each frame and applied before the next, so the last one can still be read
+    float m_nextRenderScale{1.0f};
+
+    TextureArray m_textureArray;
+    Buffer m_materialBuffer;
+    // set for the material ids that have a texture, draws without any of them use UNTEXTURED
+    std::vector<uint8_t> m_texturedMaterials;
+    float m_reach{0.0f};
+    float m_maxPointSize{1.0f};
+    bool m_crosshair{true};
+    // the depth prepass is the DEPTH_ONLY variant of the billboards
+    ShaderVariants m_screenVariants{"shaders/screen.vert", "shaders/screen.frag"};
+    Shader m_visibilityShader;
+    ShaderVariants m_resolveVariants{"shaders/raymarch.vert", "shaders/resolve.frag"};
+    ShaderVariants m_meshVariants{"shaders/mesh.vert", "shaders/mesh.frag"};
+    ShaderVariants m_rayMarchVariants{"shaders/raymarch.vert", "shaders/raymarch.frag"};
+    Shader m_temporalShader;
+    // the full screen triangle is generated from gl_VertexID
+    VertexArray m_emptyVertexArray;
+
+    [[nodiscard]] bool isUpscaling() const {
+        return m_renderWidth != m_width || m_renderHeight != m_height;
+    }
+
+    // renders at the internal resolution
+    void renderScene(World &world, const Camera &camera);
+
+    // blends the internal frame into the history, camera is the one without jitter
+    void upscale(const Camera &camera, const glm::vec2 &jitter);
+
+    // the cheapest variant that still shades everything that is drawn
+    [[nodiscard]] uint32_t getShadingKey(bool textured) const {
+        return (m_crosshair ? 0 : ShaderVariants::NO_CROSSHAIR) | (textured ? 0 : ShaderVariants::UNTEXTURED);
+    }
+
+    // uniforms of the variants that don't change from frame to frame
+    void setupVariant(const Shader &shader) const;
+
+    // untextured is drawn instead of shader where none of the materials has a texture, per chunk
+    // with CPU culling and for the whole world with the multi draw of the GPU culler. without
+    // culling the GPU culler draws the commands of its last render again
+    void drawInstances(World &world, const Shader &shader, const Shader &untextured, const Camera &camera,
+                       const Framebuffer &framebuffer, bool cull);
+
+    void rayMarch(World &world, const Camera &camera);
+
+    void resolve(const World &world, const Camera &camera);
+};
@@ -0,0 +1,75 @@
+
+#include "resolution_controller.h"
+
+#include <algorithm>
+#include <cmath>
+
+ResolutionController::ResolutionController() {
+    glCreateQueries(GL_TIME_ELAPSED, static_cast<GLsizei>(m_queries.size()), m_queries.data());
+}
+
+ResolutionController::~ResolutionController() {
+    glDeleteQueries(static_cast<GLsizei>(m_queries.size()), m_queries.data());
+}
+
+void ResolutionController::beginFrame() {
+    glBeginQuery(GL_TIME_ELAPSED, m_queries[m_frame % QUERY_COUNT]);
+}
+
+float ResolutionController::endFrame(float scale) {
+    glEndQuery(GL_TIME_ELAPSED);
+    m_queryScales[m_frame % QUERY_COUNT] = scale;
+
+    // the oldest query is begun again next frame, a result that isn't there by then is skipped
+    uint64_t sampleFrame = m_frame + 1 - QUERY_COUNT;
+    GLuint query = m_queries[(m_frame + 1) % QUERY_COUNT];
+    float sampleScale = m_queryScales[(m_frame + 1) % QUERY_COUNT];
+    ++m_frame;
+    if (m_frame < QUERY_COUNT)
+        return scale;
+
+    GLint available = 0;
+    glGetQueryObjectiv(query, GL_QUERY_RESULT_AVAILABLE, &available);
+    if (!available)
+        return scale;
+
+    GLuint64 nanoseconds = 0;
+    glGetQueryObjectui64v(query, GL_QUERY_RESULT, &nanoseconds);
+    m_lastMilliseconds = static_cast<double>(nanoseconds) / 1e6;
+    ++m_histogram[std::min(static_cast<size_t>(m_lastMilliseconds), HISTOGRAM_BUCKETS - 1)];
+
+    if (m_target <= 0.0)
+        return scale;
+    // a single hitch, e.g. from uploads, counts as no more than four times the target
+    double milliseconds = std::min(m_lastMilliseconds, m_target * 4.0);
+
+    // over budget at this scale or a smaller one, so this scale is over budget too. frames rendered at
+    // a larger scale before a drop are still in flight and are expected to be over
+    if (milliseconds > m_target && sampleScale <= scale)
+        return changeScale(scale, milliseconds);
+
+    // frames rendered before the last change say nothing about growing the current scale
+    if (sampleFrame < m_lastChange)
+        return scale;
+    m_smoothedMilliseconds = m_hasSample ? m_smoothedMilliseconds * 0.75 + milliseconds * 0.25 : milliseconds;
+    m_hasSample = true;
+    if (m_frame - m_lastChange < SETTLE_FRAMES || m_smoothedMilliseconds >= m_target * HEADROOM)
+        return scale;
+    return changeScale(scale, m_smoothedMilliseconds);
+}
+
+float ResolutionController::changeScale(float scale, double milliseconds) {
+    // the time is roughly proportional to the pixel count, which is the square of the scale
+    double aim = m_target * (1.0 + HEADROOM) * 0.5;
+    auto factor = static_cast<float>(std::sqrt(aim / milliseconds));
+    float next = scale * std::clamp(factor, 1.0f / MAX_STEP_FACTOR, MAX_STEP_FACTOR);
+    next = std::floor(next / SCALE_STEP) * SCALE_STEP;
+    next = std::clamp(next, MIN_SCALE, MAX_SCALE);
+    if (next == scale)
+        return scale;
+
+    m_changes.push_back({m_frame, next, milliseconds});
+    m_lastChange = m_frame;
+    m_hasSample = false;
+    return next;
+}
@@ -0,0 +1,97 @@
+#pragma once
+
+#include <GL/glew.h>
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+struct ResolutionChange {
+    uint64_t frame{0};
+    float scale{1.0f};
+    // GPU time that triggered the change, of a single frame when the scale dropped and smoothed when it grew
+    double milliseconds{0.0};
+};
+
+// Picks the render scale of every frame so that the GPU time of a frame stays
+// within a budget. The time is measured with timer queries that are read a few
+// frames later so they never stall. The scale drops right away when a frame
+// rendered at the current scale or a smaller one is over budget, and only grows
+// back once the smoothed time of the frames since the last change has a clear
+// margin below it and they had a few frames to settle, so it doesn't oscillate.
+class ResolutionController {
+public:
+    // frame times are counted in 1 ms buckets, the last one holds all slower frames
+    static constexpr size_t HISTOGRAM_BUCKETS = 64;
+
+    ResolutionController();
+
+    ~ResolutionController();
+
+    ResolutionController(const ResolutionController &other) = delete;
+
+    ResolutionController &operator=(const ResolutionController &other) = delete;
+
+    // 0 disables the controller
+    void setTarget(double milliseconds) {
+        m_target = milliseconds;
+    }
+
+    [[nodiscard]] double getTarget() const {
+        return m_target;
+    }
+
+    [[nodiscard]] bool isEnabled() const {
+        return m_target > 0.0;
+    }
+
+    // brackets the GPU work of a frame, no other time elapsed query may be active in between
+    void beginFrame();
+
+    // returns the scale the next frame should be rendered at, scale is the one of this frame
+    float endFrame(float scale);
+
+    [[nodiscard]] double getLastMilliseconds() const {
+        return m_lastMilliseconds;
+    }
+
+    [[nodiscard]] const std::array<uint32_t, HISTOGRAM_BUCKETS> &getHistogram() const {
+        return m_histogram;
+    }
+
+    [[nodiscard]] const std::vector<ResolutionChange> &getChanges() const {
+        return m_changes;
+    }
+
+private:
+    // enough frames in flight that the oldest query has finished
+    static constexpr size_t QUERY_COUNT = 4;
+    // the scale only changes in steps of this size to keep framebuffer reallocations rare
+    static constexpr float SCALE_STEP = 1.0f / 32.0f;
+    static constexpr float MIN_SCALE = 0.25f;
+    static constexpr float MAX_SCALE = 1.0f;
+    // the scale only grows while frames are this much faster than the target
+    static constexpr double HEADROOM = 0.8;
+    // frames measured at the new scale before it may grow again
+    static constexpr uint64_t SETTLE_FRAMES = QUERY_COUNT + 4;
+    // a single step changes the scale by at most this factor, e.g. after a hitch from uploads
+    static constexpr float MAX_STEP_FACTOR = 1.25f;
+
+    std::array<GLuint, QUERY_COUNT> m_queries{};
+    // the scale each query's frame was rendered at
+    std::array<float, QUERY_COUNT> m_queryScales{};
+    uint64_t m_frame{0};
+    uint64_t m_lastChange{0};
+    double m_target{0.0};
+    // exponential moving average of the measured frames since the last change
+    double m_smoothedMilliseconds{0.0};
+    double m_lastMilliseconds{0.0};
+    bool m_hasSample{false};
+
+    std::array<uint32_t, HISTOGRAM_BUCKETS> m_histogram{};
+    std::vector<ResolutionChange> m_changes;
+
+    // the scale that brings milliseconds to the middle of the band between the headroom and the target
+    float changeScale(float scale, double milliseconds);
+};
@@ -3,6 +3,7 @@
 
 #include <glm/gtc/type_ptr.hpp>
 
+#include <algorithm>
 #include <fstream>
 #include <sstream>
 #include <iostream>
@@ -112,7 +113,17 @@ void Shader::setBuffer(const char *name, const Buffer &buffer, unsigned int bind
     glBindBufferBase(GL_UNIFORM_BUFFER, binding, buffer.getId());
 }
 
-GLuint Shader::createFromFile(const char *path) {
+void Shader::setStorageBuffer(const char *name, const Buffer &buffer, unsigned int binding) const {
+    GLuint storageBlockIndex = glGetProgramResourceIndex(m_id, GL_SHADER_STORAGE_BLOCK, name);
+    glShaderStorageBlockBinding(m_id, storageBlockIndex, binding);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, binding, buffer.getId());
+}
+
+void Shader::dispatch(GLuint x, GLuint y, GLuint z) const {
+    glDispatchCompute(x, y, z);
+}
+
+GLuint Shader::createFromFile(const char *path, const std::vector<std::string> &defines) {
     std::string code;
     std::ifstream shaderFile;
     // ensure ifstream objects can throw exceptions:
@@ -132,6 +143,20 @@ GLuint Shader::createFromFile(const char *path) {
         std::cout << "ERROR::SHADER::FILE_NOT_SUCCESSFULLY_READ" << std::endl;
     }
 
+    if (!defines.empty()) {
+        // #version has to stay first, #line keeps the line numbers of errors those of the file
+        size_t version = code.find("#version");
+        size_t lineEnd = version == std::string::npos ? std::string::npos : code.find('\n', version);
+        if (lineEnd != std::string::npos) {
+            int line = 2 + static_cast<int>(std::count(code.begin(), code.begin() + static_cast<long>(lineEnd), '\n'));
+            std::string preamble;
+            for (const std::string &define: defines)
+                preamble += "#define " + define + "\n";
+            preamble += "#line " + std::to_string(line) + "\n";
+            code.insert(lineEnd + 1, preamble);
+        }
+    }
+
     const char *shaderCode = code.c_str();
 
     return compileShader(shaderCode, getShaderType(path));
@@ -5,6 +5,7 @@
 
 #include <unordered_map>
 #include <string>
+#include <vector>
 
 #include "buffer.h"
 
@@ -18,7 +19,13 @@ public:
 
     template<typename... Args>
     void init(Args... args) {
-        createFromFiles(args...);
+        initWithDefines({}, args...);
+    }
+
+    // compiles every stage with a #define for each of defines right after its #version line
+    template<typename... Args>
+    void initWithDefines(const std::vector<std::string> &defines, Args... args) {
+        createFromFiles(defines, args...);
         getUniforms();
     }
 
@@ -30,6 +37,11 @@ public:
         glDeleteProgram(m_id);
     }
 
+    // uniforms the compiler found unused are not active either
+    [[nodiscard]] bool hasUniform(const char *name) const {
+        return m_uniformLocations.find(name) != m_uniformLocations.end();
+    }
+
     void setInt(const char *name, int value) const;
 
     void setIVec2(const char *name, const glm::ivec2 &vec) const;
@@ -54,6 +66,10 @@ public:
 
     void setBuffer(const char *name, const Buffer &buffer, unsigned int binding) const;
 
+    void setStorageBuffer(const char *name, const Buffer &buffer, unsigned int binding) const;
+
+    void dispatch(GLuint x, GLuint y = 1, GLuint z = 1) const;
+
 private:
     GLuint m_id{0};
 
@@ -62,9 +78,9 @@ private:
     static GLenum getShaderType(const char *path);
 
     template<typename... Args>
-    void createFromFiles(Args... args) {
+    void createFromFiles(const std::vector<std::string> &defines, Args... args) {
         std::initializer_list<GLuint> shaders = {
-            createFromFile(args)...
+            createFromFile(args, defines)...
         };
 
         m_id = glCreateProgram();
@@ -79,7 +95,7 @@ private:
             glDeleteShader(shader);
     }
 
-    static GLuint createFromFile(const char *path);
+    static GLuint createFromFile(const char *path, const std::vector<std::string> &defines);
 
     static GLuint compileShader(const char *code, GLenum type);
 
@@ -0,0 +1,39 @@
+
+#include "shader_variants.h"
+
+#include <utility>
+#include <vector>
+
+ShaderVariants::ShaderVariants(std::string vertexPath, std::string fragmentPath)
+    : m_vertexPath(std::move(vertexPath)), m_fragmentPath(std::move(fragmentPath)) {
+}
+
+const Shader &ShaderVariants::get(uint32_t key) {
+    auto it = m_variants.find(key);
+    if (it != m_variants.end())
+        return *it->second;
+
+    std::vector<std::string> defines;
+    if (key & AXIS_ALIGNED)
+        defines.emplace_back("AXIS_ALIGNED");
+    if (key & UNTEXTURED)
+        defines.emplace_back("UNTEXTURED");
+    if (key & NO_CROSSHAIR)
+        defines.emplace_back("NO_CROSSHAIR");
+    if (key & DEPTH_ONLY)
+        defines.emplace_back("DEPTH_ONLY");
+
+    auto shader = std::make_unique<Shader>();
+    shader->initWithDefines(defines, m_vertexPath.c_str(), m_fragmentPath.c_str());
+    shader->use();
+    if (m_setup)
+        m_setup(*shader);
+    return *m_variants.emplace(key, std::move(shader)).first->second;
+}
+
+void ShaderVariants::forEach(const std::function<void(const Shader &)> &f) const {
+    for (auto &variant: m_variants) {
+        variant.second->use();
+        f(*variant.second);
+    }
+}
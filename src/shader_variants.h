@@ -0,0 +1,50 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <unordered_map>
+
+#include "shader.h"
+
+// A vertex and fragment shader compiled with different sets of #defines, each
+// set of features a draw doesn't need is compiled out of its own program.
+// Programs are compiled the first time their key is asked for and kept after.
+class ShaderVariants {
+public:
+    // the box is never rotated, intersectBox skips the rotation
+    static constexpr uint32_t AXIS_ALIGNED = 1u << 0;
+    // none of the drawn materials has a texture
+    static constexpr uint32_t UNTEXTURED = 1u << 1;
+    static constexpr uint32_t NO_CROSSHAIR = 1u << 2;
+    // only the depth of the hit is written, for the depth prepass
+    static constexpr uint32_t DEPTH_ONLY = 1u << 3;
+
+    ShaderVariants(std::string vertexPath, std::string fragmentPath);
+
+    ShaderVariants(const ShaderVariants &other) = delete;
+
+    ShaderVariants &operator=(const ShaderVariants &other) = delete;
+
+    // runs right after a variant is compiled, for the bindings and uniforms that rarely change
+    void setSetup(std::function<void(const Shader &)> setup) {
+        m_setup = std::move(setup);
+    }
+
+    // the program with the #defines of the bits of key, compiled on first use
+    const Shader &get(uint32_t key);
+
+    // calls f for every variant compiled so far
+    void forEach(const std::function<void(const Shader &)> &f) const;
+
+    [[nodiscard]] size_t getCompiledCount() const {
+        return m_variants.size();
+    }
+
+private:
+    std::string m_vertexPath;
+    std::string m_fragmentPath;
+    std::function<void(const Shader &)> m_setup;
+    std::unordered_map<uint32_t, std::unique_ptr<Shader>> m_variants;
+};
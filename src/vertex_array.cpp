@@ -52,4 +52,4 @@ void VertexArray::pushVertexBuffer(const Buffer &vb,
 
 void VertexArray::setElementBuffer(const Buffer &eb) const {
     glVertexArrayElementBuffer(m_id, eb.getId());
-}
\ No newline at end of file
+}
@@ -1,30 +1,12 @@
 
 #include "chunk.h"
 
-Chunk::Chunk() : m_vertexBuffer(BufferUsage::DynamicDraw) {
-    static Buffer m_billboardVertexBuffer;
-    constexpr float r = 1.73205080757f / 2.0f;
-    constexpr float billboardVertices[] {
-        -r, r, 0.0f,
-        -r, -r, 0.0f,
-        r, -r, 0.0f,
-        r, -r, 0.0f,
-        r, r, 0.0f,
-        -r, r, 0.0f
-    };
-
-    if (m_billboardVertexBuffer.getSize() == 0) {
-        m_billboardVertexBuffer.setData(billboardVertices, sizeof(billboardVertices));
-    }
-
-    m_vertexArray.pushVertexBuffer(m_billboardVertexBuffer, {
-        VertexArrayAttrib(0, VertexType::Float, 3, VertexInternalType::Float) // billboard vertices
-    }, 0);
+Chunk::Chunk() : m_gridBuffer(BufferUsage::DynamicDraw) {
+}
 
-    m_vertexArray.pushVertexBuffer(m_vertexBuffer, {
-        VertexArrayAttrib(1, VertexType::UnsignedInt, 1, VertexInternalType::Int), // voxel position
-        VertexArrayAttrib(2, VertexType::UnsignedInt, 1, VertexInternalType::Int) // voxel material
-    }, 1);
+Chunk::~Chunk() {
+    if (m_storage)
+        m_storage->free(m_firstInstance, m_instanceCapacity);
 }
 
 void Chunk::fill(const std::function<std::optional<Voxel>(glm::ivec3)> &func) {
@@ -33,28 +15,58 @@ void Chunk::fill(const std::function<std::optional<Voxel>(glm::ivec3)> &func) {
         auto voxel = func(pos);
         if (voxel) {
             assert(!voxel->isEmpty());
-            m_voxels.emplace(voxel.value());
+            if (m_voxels.emplace(voxel.value()).second) {
+                setOccupied(pos, true);
+                updateSliceCounts(voxel->getPosition(), 1);
+                countMaterial(voxel->getMaterialID(), 1);
+                ++m_clusterSolidCounts[clusterIndex(0, pos)];
+            }
         }
     }
+
+    m_visible.clear();
+    for (auto &voxel: m_voxels) {
+        updateExposure(voxel.getPosition(), voxel.getMaterialID());
+    }
+    if (!m_grid.empty())
+        buildGrid();
+
+    m_connectivityDirty = true;
+    m_gridDirty = true;
     m_dirty = true;
 }
 
 Voxel Chunk::getVoxel(const glm::ivec3 &position) {
-    auto it = m_voxels.find(Voxel(position, 0));
-    if (it != m_voxels.end()) {
-        return *it;
+    uint32_t material = getMaterial(position);
+    if (material != EMPTY_VOXEL) {
+        return Voxel(position, material);
     }
     return Voxel(position);
 }
 
 void Chunk::addVoxel(const Voxel &voxel) {
     assert(!voxel.isEmpty());
-    m_voxels.emplace(voxel);
+    if (!m_voxels.emplace(voxel).second)
+        return;
+    setOccupied(voxel.getPosition(), true);
+    setCell(voxel.getPosition(), voxel.getMaterialID());
+    updateSliceCounts(voxel.getPosition(), 1);
+    countMaterial(voxel.getMaterialID(), 1);
+    ++m_clusterSolidCounts[clusterIndex(0, voxel.getPosition())];
+    updateExposureAround(voxel.getPosition());
     m_dirty = true;
 }
 
 bool Chunk::removeVoxel(const glm::ivec3 &position) {
-    if (m_voxels.erase(Voxel(position)) > 0) {
+    auto voxel = m_voxels.find(Voxel(position));
+    if (voxel != m_voxels.end()) {
+        countMaterial(voxel->getMaterialID(), -1);
+        m_voxels.erase(voxel);
+        setOccupied(position, false);
+        setCell(position, EMPTY_VOXEL);
+        updateSliceCounts(position, -1);
+        --m_clusterSolidCounts[clusterIndex(0, position)];
+        updateExposureAround(position);
         m_dirty = true;
         return true;
     }
@@ -62,19 +74,503 @@ bool Chunk::removeVoxel(const glm::ivec3 &position) {
 }
 
 bool Chunk::isVoxelEmpty(const glm::ivec3 &position) {
-    return getVoxel(position).isEmpty();
+    return !isOccupied(position);
 }
 
-void Chunk::upload() {
-    std::vector<Voxel> voxels(m_voxels.begin(), m_voxels.end());
-    m_vertexBuffer.setData(voxels);
-    m_count = static_cast<GLsizei>(voxels.size());
+void Chunk::setNeighbor(int direction, const Chunk *chunk) {
+    m_neighbors[direction] = chunk;
+}
+
+bool Chunk::isSolid(glm::ivec3 position) const {
+    // only ever called with direct neighbors, so at most one axis is outside the chunk
+    const Chunk *chunk = this;
+    for (int axis = 0; axis < 3; ++axis) {
+        if (position[axis] < 0) {
+            chunk = m_neighbors[axis * 2 + 1];
+            position[axis] += CHUNK_SIZE;
+        } else if (position[axis] >= CHUNK_SIZE) {
+            chunk = m_neighbors[axis * 2];
+            position[axis] -= CHUNK_SIZE;
+        }
+    }
+    return chunk && chunk->isOccupied(position);
+}
+
+bool Chunk::isSolid(int level, const glm::ivec3 &cell) const {
+    if (level == 0)
+        return isSolid(cell);
+    return isInside(cell, CHUNK_SIZE >> level) && m_grid[cellToIndex(level, cell)] != EMPTY_VOXEL;
+}
+
+bool Chunk::updateExposure(const glm::ivec3 &position) {
+    return updateExposure(position, getMaterial(position));
+}
+
+bool Chunk::updateExposure(const glm::ivec3 &position, uint32_t material) {
+    bool exposed = false;
+    if (material != EMPTY_VOXEL) {
+        for (auto &offset: NEIGHBOR_OFFSETS) {
+            if (!isSolid(position + offset)) {
+                exposed = true;
+                break;
+            }
+        }
+    }
+
+    bool changed;
+    if (exposed) {
+        changed = m_visible.emplace(position, material).second;
+    } else {
+        changed = m_visible.erase(Voxel(position)) > 0;
+    }
+    if (changed)
+        m_dirty = true;
+    return changed;
+}
+
+void Chunk::updateExposureAround(const glm::ivec3 &position) {
+    updateExposure(position);
+    // neighbors in other chunks are updated by the world
+    for (auto &offset: NEIGHBOR_OFFSETS) {
+        if (isInside(position + offset))
+            updateExposure(position + offset);
+    }
+}
+
+bool Chunk::updateBorderExposure(int direction) {
+    int axis = direction / 2;
+    int layer = (direction & 1) ? 0 : CHUNK_SIZE - 1;
+    int u = (axis + 1) % 3;
+    int v = (axis + 2) % 3;
+
+    bool changed = false;
+    glm::ivec3 position;
+    position[axis] = layer;
+    for (position[u] = 0; position[u] < CHUNK_SIZE; ++position[u]) {
+        for (position[v] = 0; position[v] < CHUNK_SIZE; ++position[v]) {
+            changed |= updateExposure(position);
+        }
+    }
+    return changed;
+}
+
+void Chunk::attach(ChunkStorage *storage, size_t index, const glm::vec3 &origin) {
+    m_storage = storage;
+    m_index = index;
+    m_origin = origin;
+}
+
+void Chunk::setBuildMode(ChunkBuildMode mode) {
+    if (m_buildMode != mode) {
+        m_buildMode = mode;
+        m_gridDirty = true;
+        m_dirty = true;
+    }
+}
+
+void Chunk::setCell(const glm::ivec3 &position, uint32_t material) {
+    m_connectivityDirty = true;
+    if (m_grid.empty())
+        return;
+    writeCell(positionToIndex(position), material);
+
+    // only the cells above the edited voxel can change, stop as soon as one doesn't
+    glm::ivec3 cell = position;
+    for (int level = 1; level < LOD_LEVELS; ++level) {
+        cell /= 2;
+        int index = cellToIndex(level, cell);
+        uint32_t downsampled = downsample(level, cell);
+        if (m_grid[index] == downsampled)
+            break;
+        writeCell(index, downsampled);
+    }
+}
+
+void Chunk::writeCell(int index, uint32_t material) {
+    uint32_t previous = m_grid[index];
+    if (previous == material)
+        return;
+    m_grid[index] = material;
+
+    int level = 0;
+    while (level + 1 < LOD_LEVELS && index >= getLevelOffset(level + 1))
+        ++level;
+    m_solidCells[level] += previous == EMPTY_VOXEL ? 1 : material == EMPTY_VOXEL ? -1 : 0;
+
+    if (!m_gridDirty) {
+        if (m_dirtyCells.size() < MAX_PARTIAL_GRID_UPLOADS) {
+            m_dirtyCells.push_back(index);
+        } else {
+            m_gridDirty = true;
+        }
+    }
+}
+
+uint32_t Chunk::downsample(int level, const glm::ivec3 &cell) const {
+    // most common material among the solid children, the first one wins a tie
+    std::array<uint32_t, 8> materials{};
+    std::array<int, 8> counts{};
+    int distinct = 0;
+    for (int i = 0; i < 8; ++i) {
+        glm::ivec3 child = cell * 2 + glm::ivec3(i >> 2, (i >> 1) & 1, i & 1);
+        uint32_t material = m_grid[cellToIndex(level - 1, child)];
+        if (material == EMPTY_VOXEL)
+            continue;
+        int j = 0;
+        while (j < distinct && materials[j] != material)
+            ++j;
+        if (j == distinct)
+            materials[distinct++] = material;
+        ++counts[j];
+    }
+
+    uint32_t result = EMPTY_VOXEL;
+    int best = 0;
+    for (int j = 0; j < distinct; ++j) {
+        if (counts[j] > best) {
+            best = counts[j];
+            result = materials[j];
+        }
+    }
+    return result;
+}
+
+const std::vector<uint32_t> &Chunk::getGrid() const {
+    if (m_grid.empty())
+        buildGrid();
+    return m_grid;
+}
+
+void Chunk::buildGrid() const {
+    m_grid.assign(GRID_SIZE, EMPTY_VOXEL);
+    m_gridDirty = true;
+    m_dirtyCells.clear();
+    for (auto &voxel: m_voxels)
+        m_grid[positionToIndex(voxel.getPosition())] = voxel.getMaterialID();
+
+    m_solidCells.fill(0);
+    m_solidCells[0] = static_cast<GLuint>(m_voxels.size());
+    for (int level = 1; level < LOD_LEVELS; ++level) {
+        int size = CHUNK_SIZE >> level;
+        glm::ivec3 cell;
+        for (cell.x = 0; cell.x < size; ++cell.x) {
+            for (cell.y = 0; cell.y < size; ++cell.y) {
+                for (cell.z = 0; cell.z < size; ++cell.z) {
+                    uint32_t material = downsample(level, cell);
+                    m_grid[cellToIndex(level, cell)] = material;
+                    if (material != EMPTY_VOXEL)
+                        ++m_solidCells[level];
+                }
+            }
+        }
+    }
+}
+
+void Chunk::updateConnectivity() {
+    m_faceConnections.fill(0);
+    std::vector<bool> visited(CHUNK_SIZE_CUBED, false);
+    std::vector<int> stack;
+
+    // components that don't touch a face can't connect any, so only the faces are seeds
+    for (int seed = 0; seed < CHUNK_SIZE_CUBED; ++seed) {
+        int x = seed / CHUNK_SIZE_SQUARED;
+        int y = (seed / CHUNK_SIZE) % CHUNK_SIZE;
+        int z = seed % CHUNK_SIZE;
+        bool onFace = x == 0 || y == 0 || z == 0 || x == CHUNK_SIZE - 1 || y == CHUNK_SIZE - 1 || z == CHUNK_SIZE - 1;
+        if (!onFace || visited[seed] || isOccupied({x, y, z}))
+            continue;
+
+        uint8_t faces = 0;
+        visited[seed] = true;
+        stack.push_back(seed);
+        while (!stack.empty()) {
+            int index = stack.back();
+            stack.pop_back();
+
+            glm::ivec3 position(index / CHUNK_SIZE_SQUARED, (index / CHUNK_SIZE) % CHUNK_SIZE, index % CHUNK_SIZE);
+            for (int direction = 0; direction < 6; ++direction) {
+                glm::ivec3 neighbor = position + NEIGHBOR_OFFSETS[direction];
+                if (!isInside(neighbor)) {
+                    faces |= 1u << direction;
+                    continue;
+                }
+                int neighborIndex = positionToIndex(neighbor);
+                if (!visited[neighborIndex] && !isOccupied(neighbor)) {
+                    visited[neighborIndex] = true;
+                    stack.push_back(neighborIndex);
+                }
+            }
+        }
+
+        for (int direction = 0; direction < 6; ++direction) {
+            if (faces & (1u << direction))
+                m_faceConnections[direction] |= faces;
+        }
+    }
+    m_connectivityDirty = false;
+}
+
+void Chunk::setOccupied(const glm::ivec3 &position, bool occupied) {
+    uint64_t &row = m_occupancy[position.x * CHUNK_SIZE + position.y];
+    uint64_t bit = uint64_t(1) << position.z;
+    row = occupied ? row | bit : row & ~bit;
+}
+
+uint32_t Chunk::getMaterial(const glm::ivec3 &position) const {
+    if (!isOccupied(position))
+        return EMPTY_VOXEL;
+    return m_voxels.find(Voxel(position))->getMaterialID();
+}
+
+void Chunk::updateSliceCounts(const glm::ivec3 &position, int delta) {
+    for (int axis = 0; axis < 3; ++axis) {
+        m_sliceCounts[axis][position[axis]] += delta;
+    }
+}
+
+void Chunk::countMaterial(uint32_t material, int delta) {
+    if (material >= m_materialCounts.size())
+        m_materialCounts.resize(material + 1);
+    m_materialCounts[material] += delta;
+}
+
+bool Chunk::hasAnyMaterial(const std::vector<uint8_t> &materials) const {
+    size_t count = std::min(materials.size(), m_materialCounts.size());
+    for (size_t material = 0; material < count; ++material) {
+        if (materials[material] && m_materialCounts[material] > 0)
+            return true;
+    }
+    return false;
+}
+
+bool Chunk::getBounds(glm::ivec3 &min, glm::ivec3 &max) const {
+    if (m_voxels.empty())
+        return false;
+
+    for (int axis = 0; axis < 3; ++axis) {
+        auto &counts = m_sliceCounts[axis];
+        int first = 0;
+        while (counts[first] == 0)
+            ++first;
+        int last = CHUNK_SIZE - 1;
+        while (counts[last] == 0)
+            --last;
+        min[axis] = first;
+        max[axis] = last;
+    }
+    return true;
+}
+
+size_t Chunk::getUploadSize() const {
+    if (m_buildMode == ChunkBuildMode::GpuCompaction) {
+        return m_gridDirty ? GRID_SIZE * sizeof(uint32_t) : m_dirtyCells.size() * sizeof(uint32_t);
+    }
+    return m_instances.size() * (sizeof(Voxel) + sizeof(InstanceOrder));
+}
+
+void Chunk::rebuild() {
+    if (m_connectivityDirty)
+        updateConnectivity();
+
+    m_instances.clear();
+    m_orders.clear();
+    m_clusters.clear();
+    m_levelCounts.fill(0);
+    if (m_buildMode == ChunkBuildMode::Cpu) {
+        buildClusters(0, std::vector<Voxel>(m_visible.begin(), m_visible.end()));
+
+        // the coarser levels are small enough to be scanned completely, a chunk that doesn't keep its
+        // grid builds one just for this
+        bool temporaryGrid = m_grid.empty();
+        const std::vector<uint32_t> &grid = getGrid();
+        std::vector<Voxel> voxels;
+        for (int level = 1; level < LOD_LEVELS; ++level) {
+            int size = CHUNK_SIZE >> level;
+            voxels.clear();
+            glm::ivec3 cell;
+            for (cell.x = 0; cell.x < size; ++cell.x) {
+                for (cell.y = 0; cell.y < size; ++cell.y) {
+                    for (cell.z = 0; cell.z < size; ++cell.z) {
+                        uint32_t material = grid[cellToIndex(level, cell)];
+                        if (material == EMPTY_VOXEL)
+                            continue;
+                        for (auto &offset: NEIGHBOR_OFFSETS) {
+                            if (!isSolid(level, cell + offset)) {
+                                voxels.emplace_back(cell, material);
+                                break;
+                            }
+                        }
+                    }
+                }
+            }
+            buildClusters(level, voxels);
+        }
+        if (temporaryGrid)
+            std::vector<uint32_t>().swap(m_grid);
+    }
     m_dirty = false;
 }
 
-void Chunk::render() {
-    m_vertexArray.bind();
-    if (m_dirty)
-        upload();
-    glDrawArraysInstanced(GL_TRIANGLES, 0, 6, m_count);
+void Chunk::buildClusters(int level, const std::vector<Voxel> &voxels) {
+    // counting sort by cluster, voxels keep their x, y, z order within each cluster which is
+    // instance order 0
+    std::array<GLuint, CLUSTERS_PER_CHUNK> counts{};
+    for (auto &voxel: voxels) {
+        ++counts[clusterIndex(level, voxel.getPosition())];
+    }
+
+    auto base = static_cast<GLuint>(m_instances.size());
+    size_t firstCluster = m_clusters.size();
+    m_clusters.resize(firstCluster + CLUSTERS_PER_CHUNK);
+    GLuint first = base;
+    for (int i = 0; i < CLUSTERS_PER_CHUNK; ++i) {
+        ClusterInfo &cluster = m_clusters[firstCluster + i];
+        cluster.boundsMin = glm::vec4(CHUNK_SIZE);
+        cluster.boundsMax = glm::vec4(0.0f);
+        cluster.firstInstance = first;
+        first += counts[i];
+    }
+
+    auto scale = static_cast<float>(1 << level);
+    m_instances.resize(base + voxels.size());
+    for (auto &voxel: voxels) {
+        glm::ivec3 cell = voxel.getPosition();
+        ClusterInfo &cluster = m_clusters[firstCluster + clusterIndex(level, cell)];
+        m_instances[cluster.firstInstance + cluster.instanceCount++] = voxel;
+
+        cluster.boundsMin = glm::min(cluster.boundsMin, glm::vec4(glm::vec3(cell) * scale, 0.0f));
+        cluster.boundsMax = glm::max(cluster.boundsMax, glm::vec4(glm::vec3(cell + 1) * scale, 0.0f));
+        for (int direction = 0; direction < 6; ++direction) {
+            if (!isSolid(level, cell + NEIGHBOR_OFFSETS[direction]))
+                cluster.faceMask |= 1u << direction;
+        }
+    }
+    m_levelCounts[level] = static_cast<GLuint>(voxels.size());
+
+    // the offsets of orders 1 to 3 from every slot to the instance drawn there like compact.comp,
+    // the rows of equal x and y are contiguous in order 0 and are walked backwards where y descends,
+    // their voxels where z does
+    m_orders.resize(m_instances.size(), InstanceOrder(0));
+    std::vector<GLuint> rows;
+    std::vector<GLuint> slabs;
+    for (int i = 0; i < CLUSTERS_PER_CHUNK; ++i) {
+        const ClusterInfo &cluster = m_clusters[firstCluster + i];
+        const Voxel *instances = m_instances.data() + cluster.firstInstance;
+        rows.clear();
+        slabs.clear();
+        for (GLuint index = 0; index < cluster.instanceCount; ++index) {
+            glm::ivec3 cell = instances[index].getPosition();
+            glm::ivec3 previous = index > 0 ? glm::ivec3(instances[index - 1].getPosition()) : cell - 1;
+            if (cell.x != previous.x)
+                slabs.push_back(static_cast<GLuint>(rows.size()));
+            if (cell.x != previous.x || cell.y != previous.y)
+                rows.push_back(index);
+        }
+        slabs.push_back(static_cast<GLuint>(rows.size()));
+        rows.push_back(cluster.instanceCount);
+
+        for (int order = 1; order < INSTANCE_ORDERS; ++order) {
+            int shift = (order - 1) % 2 * 16;
+            GLuint slot = 0;
+            for (size_t slab = 0; slab + 1 < slabs.size(); ++slab) {
+                for (GLuint row = slabs[slab]; row < slabs[slab + 1]; ++row) {
+                    GLuint r = order & 2 ? slabs[slab] + slabs[slab + 1] - 1 - row : row;
+                    for (GLuint index = rows[r]; index < rows[r + 1]; ++index, ++slot) {
+                        GLuint instance = order & 1 ? rows[r] + rows[r + 1] - 1 - index : index;
+                        auto offset = static_cast<GLuint>(static_cast<int32_t>(instance) - static_cast<int32_t>(slot));
+                        m_orders[cluster.firstInstance + slot][(order - 1) / 2] |= (offset & 0xFFFFu) << shift;
+                    }
+                }
+            }
+        }
+    }
+}
+
+void Chunk::upload() {
+    assert(m_storage);
+    if (m_buildMode == ChunkBuildMode::Cpu) {
+        reserveInstances(m_instances.size());
+        m_storage->write(m_firstInstance, m_instances, m_orders);
+        GLuint first = m_firstInstance;
+        for (int level = 0; level < LOD_LEVELS; ++level) {
+            m_storage->setCommand(m_index, level, {m_storage->getVerticesPerInstance(), m_levelCounts[level], 0, first});
+            m_levelFirstInstances[level] = first;
+            first += m_levelCounts[level];
+        }
+
+        std::vector<ClusterInfo> clusters(m_clusters);
+        for (auto &cluster: clusters) {
+            cluster.chunk = static_cast<GLuint>(m_index);
+            cluster.firstInstance += m_firstInstance;
+            if (cluster.instanceCount > 0) {
+                cluster.boundsMin += glm::vec4(m_origin, 0.0f);
+                cluster.boundsMax += glm::vec4(m_origin, 0.0f);
+            } else {
+                cluster.boundsMin = glm::vec4(1.0f);
+                cluster.boundsMax = glm::vec4(-1.0f);
+            }
+        }
+        m_storage->setClusters(m_index, clusters);
+        m_uploadedClusters = std::move(clusters);
+        return;
+    }
+
+    m_uploadedClusters.clear();
+    // the compaction reads every level, and the instance capacity comes from their solid cells
+    if (m_grid.empty())
+        buildGrid();
+    uploadGrid();
+
+    // the compacted list of a level never holds more instances than it has solid cells,
+    // the shader can't see neighboring chunks so it may emit more than m_visible
+    GLuint capacity = 0;
+    for (auto count: m_solidCells)
+        capacity += count;
+    reserveInstances(capacity);
+    m_storage->clearOrders(m_firstInstance, capacity);
+
+    const Shader &shader = m_storage->getCompactionShader();
+    shader.use();
+    shader.setStorageBuffer("uGrid", m_gridBuffer, 0);
+    shader.setStorageBuffer("uInstances", m_storage->getInstanceBuffer(), 1);
+    shader.setStorageBuffer("uCommands", m_storage->getCommandBuffer(), 2);
+    shader.setStorageBuffer("uClusters", m_storage->getClusterBuffer(), 3);
+    shader.setStorageBuffer("uInstanceOrders", m_storage->getOrderBuffer(), 4);
+    shader.setInt("uChunkIndex", static_cast<int>(m_index));
+    shader.setVec3("uChunkOrigin", m_origin);
+
+    GLuint first = m_firstInstance;
+    for (int level = 0; level < LOD_LEVELS; ++level) {
+        m_storage->setCommand(m_index, level, {m_storage->getVerticesPerInstance(), 0, 0, first});
+        m_levelFirstInstances[level] = first;
+        shader.setInt("uLevel", level);
+        shader.setInt("uGridOffset", getLevelOffset(level));
+        shader.setInt("uFirstInstance", static_cast<int>(first));
+        // one workgroup per cluster
+        shader.dispatch(CLUSTERS_PER_CHUNK);
+        first += m_solidCells[level];
+    }
+
+    glMemoryBarrier(GL_COMMAND_BARRIER_BIT | GL_SHADER_STORAGE_BARRIER_BIT | GL_BUFFER_UPDATE_BARRIER_BIT);
+}
+
+void Chunk::reserveInstances(size_t count) {
+    if (count <= m_instanceCapacity)
+        return;
+    m_storage->free(m_firstInstance, m_instanceCapacity);
+    // some headroom so that placing a few voxels doesn't move the chunk every time
+    m_instanceCapacity = static_cast<GLuint>(count + count / 4);
+    m_firstInstance = m_storage->allocate(m_instanceCapacity);
+}
+
+void Chunk::uploadGrid() {
+    if (m_gridDirty) {
+        m_gridBuffer.setData(m_grid);
+    } else {
+        for (auto index: m_dirtyCells) {
+            m_gridBuffer.setSubData(index * sizeof(uint32_t), &m_grid[index], sizeof(uint32_t));
+        }
+    }
+    m_dirtyCells.clear();
+    m_gridDirty = false;
 }
@@ -4,22 +4,65 @@
 #include <glm/glm.hpp>
 
 #include <set>
+#include <array>
+#include <vector>
 #include <algorithm>
 #include <functional>
 #include <optional>
 
 #include "voxel.h"
 #include "buffer.h"
-#include "vertex_array.h"
+#include "chunk_storage.h"
 
 constexpr int CHUNK_SIZE = 64;
 constexpr int CHUNK_SIZE_SQUARED = CHUNK_SIZE * CHUNK_SIZE;
 constexpr int CHUNK_SIZE_CUBED = CHUNK_SIZE * CHUNK_SIZE * CHUNK_SIZE;
+// a row of voxels along z is one word of the occupancy bitmask
+static_assert(CHUNK_SIZE == 64);
+
+// chunks are split into fixed bricks that are culled independently on the GPU
+constexpr int CLUSTER_SIZE = 16;
+constexpr int CLUSTERS_PER_AXIS = CHUNK_SIZE / CLUSTER_SIZE;
+constexpr int CLUSTERS_PER_CHUNK = CLUSTERS_PER_AXIS * CLUSTERS_PER_AXIS * CLUSTERS_PER_AXIS;
+
+// level l has CHUNK_SIZE >> l cells per axis, each covering 2^l voxels of level 0 per axis,
+// every level is split into the same CLUSTERS_PER_CHUNK clusters
+constexpr int LOD_LEVELS = 4;
+
+// start of a level in the grid of all levels
+constexpr int getLevelOffset(int level) {
+    int offset = 0;
+    for (int l = 0; l < level; ++l) {
+        int size = CHUNK_SIZE >> l;
+        offset += size * size * size;
+    }
+    return offset;
+}
+
+constexpr int GRID_SIZE = getLevelOffset(LOD_LEVELS);
+
+// +x, -x, +y, -y, +z, -z, the opposite direction is always direction ^ 1
+inline const glm::ivec3 NEIGHBOR_OFFSETS[6] = {
+    {1, 0, 0}, {-1, 0, 0},
+    {0, 1, 0}, {0, -1, 0},
+    {0, 0, 1}, {0, 0, -1}
+};
+
+enum class ChunkBuildMode {
+    Cpu, // instance list is built on the CPU and uploaded
+    GpuCompaction // dense material grid is uploaded and compacted by a compute shader
+};
 
 class Chunk {
 public:
     Chunk();
 
+    ~Chunk();
+
+    Chunk(const Chunk &other) = delete;
+
+    Chunk &operator=(const Chunk &other) = delete;
+
     void fill(const std::function<std::optional<Voxel>(glm::ivec3)>& func);
 
     Voxel getVoxel(const glm::ivec3 &position);
@@ -30,24 +73,206 @@ public:
 
     bool isVoxelEmpty(const glm::ivec3 &position);
 
-    void upload();
+    void setNeighbor(int direction, const Chunk *chunk);
+
+    // re-evaluates whether the voxel at position has an empty neighbor, returns true if that changed
+    bool updateExposure(const glm::ivec3 &position);
+
+    // re-evaluates the layer of voxels facing the neighbor in direction, returns true if anything changed
+    bool updateBorderExposure(int direction);
+
+    // true if empty space inside the chunk connects the faces towards NEIGHBOR_OFFSETS[from] and [to],
+    // as of the last rebuild
+    [[nodiscard]] bool isConnected(int from, int to) const {
+        return (m_faceConnections[from] >> to) & 1u;
+    }
+
+    [[nodiscard]] const std::array<uint8_t, 6> &getFaceConnections() const {
+        return m_faceConnections;
+    }
+
+    // the chunk's instances, draw commands and clusters live in storage at index, must be set before upload
+    void attach(ChunkStorage *storage, size_t index, const glm::vec3 &origin);
+
+    void setBuildMode(ChunkBuildMode mode);
 
-    void render();
+    void rebuild();
+
+    void upload();
 
     [[nodiscard]] size_t getVoxelCount() const {
         return m_voxels.size();
     }
 
+    [[nodiscard]] size_t getInstanceCount() const {
+        return m_visible.size();
+    }
+
+    // bit i is set if cluster i is completely filled with voxels, such clusters make good occluders
+    [[nodiscard]] uint64_t getSolidClusters() const {
+        uint64_t mask = 0;
+        for (int i = 0; i < CLUSTERS_PER_CHUNK; ++i) {
+            if (m_clusterSolidCounts[i] == CLUSTER_SIZE * CLUSTER_SIZE * CLUSTER_SIZE)
+                mask |= uint64_t(1) << i;
+        }
+        return mask;
+    }
+
+    // also looks into the neighbors for positions just outside the chunk, missing neighbors are empty
+    [[nodiscard]] bool isSolid(glm::ivec3 position) const;
+
+    // material ids of all levels one after the other, see m_grid. built on the first call and kept
+    // up to date from then on
+    [[nodiscard]] const std::vector<uint32_t> &getGrid() const;
+
+    // whether some voxel has a material whose entry in materials is set, ids past its end are not
+    [[nodiscard]] bool hasAnyMaterial(const std::vector<uint8_t> &materials) const;
+
+    // tight bounds of the occupied voxels in local coordinates (inclusive), false if the chunk is empty
+    bool getBounds(glm::ivec3 &min, glm::ivec3 &max) const;
+
+    [[nodiscard]] size_t getUploadSize() const;
+
+    [[nodiscard]] size_t getIndex() const {
+        return m_index;
+    }
+
+    // the base instance of the level's command, in the instance buffer of the storage
+    [[nodiscard]] GLuint getFirstInstance(int level) const {
+        return m_levelFirstInstances[level];
+    }
+
+    // world space clusters of every level as of the last upload, empty in GpuCompaction mode where
+    // they only exist on the GPU
+    [[nodiscard]] const std::vector<ClusterInfo> &getUploadedClusters() const {
+        return m_uploadedClusters;
+    }
+
+    [[nodiscard]] bool isDirty() const {
+        return m_dirty;
+    }
+
+    [[nodiscard]] ChunkBuildMode getBuildMode() const {
+        return m_buildMode;
+    }
+
 private:
     std::set<Voxel, Voxel::Compare> m_voxels;
-    Buffer m_vertexBuffer;
-    VertexArray m_vertexArray;
-    GLsizei m_count{0};
+    // voxels with at least one empty neighbor, the others can never be seen
+    std::set<Voxel, Voxel::Compare> m_visible;
+    // exposed cells of every level sorted by cluster, level 0 is m_visible
+    std::vector<Voxel> m_instances;
+    // the other instance orders of every cluster, parallel to m_instances
+    std::vector<InstanceOrder> m_orders;
+    std::array<GLuint, LOD_LEVELS> m_levelCounts{};
+    std::array<GLuint, LOD_LEVELS> m_levelFirstInstances{};
+    // local bounds and ranges relative to the chunk's first instance, only built in Cpu mode
+    std::vector<ClusterInfo> m_clusters;
+    // what upload wrote to the storage, m_clusters runs ahead of it while an upload is pending
+    std::vector<ClusterInfo> m_uploadedClusters;
+    std::array<const Chunk *, 6> m_neighbors{};
+    // number of voxels in each x, y and z slice, kept up to date on edit for the bounds
+    std::array<std::array<int, CHUNK_SIZE>, 3> m_sliceCounts{};
+    // number of voxels of every material id, kept up to date on edit to pick shader variants
+    std::vector<int> m_materialCounts;
     bool m_dirty{false};
 
+    // bit j of entry i is set if faces i and j are connected through empty space
+    std::array<uint8_t, 6> m_faceConnections{};
+    bool m_connectivityDirty{true};
+
+    ChunkStorage *m_storage{nullptr};
+    size_t m_index{0};
+    glm::vec3 m_origin{0.0f};
+    GLuint m_firstInstance{0};
+    GLuint m_instanceCapacity{0};
+
+    ChunkBuildMode m_buildMode{ChunkBuildMode::Cpu};
+    // bit z of word x * CHUNK_SIZE + y is set where there is a voxel of level 0, 32 KiB, enough for the
+    // exposure and connectivity, the materials stay in m_voxels
+    std::array<uint64_t, CHUNK_SIZE_SQUARED> m_occupancy{};
+    // dense material ids of all levels one after the other, EMPTY_VOXEL where there is no voxel.
+    // a cell of a coarser level has the most common material of its solid children and is only
+    // empty if all of them are, so coarse levels always cover the finer ones without cracks.
+    // GRID_SIZE words, about 1.14 MiB, so it is only kept by GpuCompaction chunks and once ray
+    // marching, the greedy meshes or the reference tracer asked for it. the CPU build makes a
+    // temporary one for the coarser levels. empty otherwise
+    mutable std::vector<uint32_t> m_grid;
+    // solid cells of every level, only counted while m_grid exists
+    mutable std::array<GLuint, LOD_LEVELS> m_solidCells{};
+    // voxels of level 0 in each cluster
+    std::array<int, CLUSTERS_PER_CHUNK> m_clusterSolidCounts{};
+    mutable std::vector<uint32_t> m_dirtyCells;
+    mutable bool m_gridDirty{true};
+    Buffer m_gridBuffer;
+
+    // above this many edited cells the whole grid is uploaded at once
+    static constexpr size_t MAX_PARTIAL_GRID_UPLOADS = 256;
+
+    // sets a voxel of level 0 and updates the coarser levels above it
+    void setCell(const glm::ivec3 &position, uint32_t material);
+
+    void writeCell(int index, uint32_t material);
+
+    [[nodiscard]] uint32_t downsample(int level, const glm::ivec3 &cell) const;
+
+    // fills m_grid from m_voxels and downsamples the coarser levels
+    void buildGrid() const;
+
+    [[nodiscard]] bool isOccupied(const glm::ivec3 &position) const {
+        return (m_occupancy[position.x * CHUNK_SIZE + position.y] >> position.z) & 1u;
+    }
+
+    void setOccupied(const glm::ivec3 &position, bool occupied);
+
+    // EMPTY_VOXEL if there is no voxel at position
+    [[nodiscard]] uint32_t getMaterial(const glm::ivec3 &position) const;
+
+    bool updateExposure(const glm::ivec3 &position, uint32_t material);
+
+    // flood fills the empty space from the chunk's faces
+    void updateConnectivity();
+
+    void updateSliceCounts(const glm::ivec3 &position, int delta);
+
+    void countMaterial(uint32_t material, int delta);
+
+    // cells outside the chunk are treated as empty above level 0
+    [[nodiscard]] bool isSolid(int level, const glm::ivec3 &cell) const;
+
+    void updateExposureAround(const glm::ivec3 &position);
+
+    // appends the voxels of level sorted by cluster to m_instances, their other orders to m_orders and
+    // their clusters to m_clusters
+    void buildClusters(int level, const std::vector<Voxel> &voxels);
+
+    void uploadGrid();
+
+    // makes sure the range in storage holds at least count instances, it may move
+    void reserveInstances(size_t count);
+
+    static int clusterIndex(int level, const glm::ivec3 &cell) {
+        glm::ivec3 cluster = cell / (CLUSTER_SIZE >> level);
+        return (cluster.x * CLUSTERS_PER_AXIS + cluster.y) * CLUSTERS_PER_AXIS + cluster.z;
+    }
+
     static glm::vec3 indexToPosition(int index) {
         return {index / CHUNK_SIZE_SQUARED,
                 (index % CHUNK_SIZE_SQUARED) / CHUNK_SIZE,
                 index % CHUNK_SIZE};
     }
+
+    static int positionToIndex(const glm::ivec3 &position) {
+        return position.x * CHUNK_SIZE_SQUARED + position.y * CHUNK_SIZE + position.z;
+    }
+
+    static int cellToIndex(int level, const glm::ivec3 &cell) {
+        int size = CHUNK_SIZE >> level;
+        return getLevelOffset(level) + (cell.x * size + cell.y) * size + cell.z;
+    }
+
+    static bool isInside(const glm::ivec3 &position, int size = CHUNK_SIZE) {
+        return position.x >= 0 && position.y >= 0 && position.z >= 0 &&
+               position.x < size && position.y < size && position.z < size;
+    }
 };
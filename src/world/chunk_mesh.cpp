@@ -0,0 +1,100 @@
+
+#include "chunk_mesh.h"
+
+#include <algorithm>
+
+ChunkMesh::ChunkMesh() {
+    m_vertexArray.pushVertexBuffer(m_vertexBuffer, {
+        VertexArrayAttrib(0, VertexType::UnsignedInt, 1, VertexInternalType::Int),
+        VertexArrayAttrib(1, VertexType::UnsignedInt, 1, VertexInternalType::Int)
+    });
+    m_vertexArray.setElementBuffer(m_indexBuffer);
+}
+
+void ChunkMesh::build(const Chunk &chunk) {
+    m_vertices.clear();
+    m_indices.clear();
+    m_mask.resize(CHUNK_SIZE_SQUARED);
+
+    const std::vector<uint32_t> &grid = chunk.getGrid();
+    for (int direction = 0; direction < 6; ++direction) {
+        // the slices are perpendicular to axis and spanned by u and v
+        int axis = direction / 2;
+        int u = (axis + 1) % 3;
+        int v = (axis + 2) % 3;
+        const glm::ivec3 &offset = NEIGHBOR_OFFSETS[direction];
+
+        for (int slice = 0; slice < CHUNK_SIZE; ++slice) {
+            // material of every face of the slice that looks into empty space
+            glm::ivec3 position;
+            position[axis] = slice;
+            for (int j = 0; j < CHUNK_SIZE; ++j) {
+                for (int i = 0; i < CHUNK_SIZE; ++i) {
+                    position[u] = i;
+                    position[v] = j;
+                    uint32_t material = grid[position.x * CHUNK_SIZE_SQUARED + position.y * CHUNK_SIZE + position.z];
+                    if (material != EMPTY_VOXEL && chunk.isSolid(position + offset))
+                        material = EMPTY_VOXEL;
+                    m_mask[j * CHUNK_SIZE + i] = material;
+                }
+            }
+
+            // grow every face along u while the material stays the same, then along v while the whole row does
+            for (int j = 0; j < CHUNK_SIZE; ++j) {
+                for (int i = 0; i < CHUNK_SIZE;) {
+                    uint32_t material = m_mask[j * CHUNK_SIZE + i];
+                    if (material == EMPTY_VOXEL) {
+                        ++i;
+                        continue;
+                    }
+
+                    int width = 1;
+                    while (i + width < CHUNK_SIZE && m_mask[j * CHUNK_SIZE + i + width] == material)
+                        ++width;
+                    int height = 1;
+                    for (; j + height < CHUNK_SIZE; ++height) {
+                        const uint32_t *row = &m_mask[(j + height) * CHUNK_SIZE + i];
+                        if (std::any_of(row, row + width, [&](uint32_t other) { return other != material; }))
+                            break;
+                    }
+                    for (int y = j; y < j + height; ++y)
+                        std::fill_n(&m_mask[y * CHUNK_SIZE + i], width, EMPTY_VOXEL);
+
+                    // faces towards + lie on the far side of the voxel
+                    glm::ivec3 origin;
+                    origin[axis] = slice + (direction % 2 == 0 ? 1 : 0);
+                    origin[u] = i;
+                    origin[v] = j;
+                    glm::ivec3 du(0), dv(0);
+                    du[u] = width;
+                    dv[v] = height;
+                    addQuad(direction, origin, du, dv, material);
+                    i += width;
+                }
+            }
+        }
+    }
+
+    m_vertexBuffer.setData(m_vertices);
+    m_indexBuffer.setData(m_indices);
+    m_vertexCount = m_vertices.size();
+    m_indexCount = m_indices.size();
+}
+
+void ChunkMesh::addQuad(int direction, const glm::ivec3 &origin, const glm::ivec3 &du, const glm::ivec3 &dv,
+                        uint32_t material) {
+    auto first = static_cast<GLuint>(m_vertices.size());
+    for (const glm::ivec3 &corner: {origin, origin + du, origin + du + dv, origin + dv}) {
+        uint32_t packed = (corner.x << 14) | (corner.y << 7) | corner.z | (direction << 21);
+        m_vertices.push_back({packed, material});
+    }
+    for (GLuint index: {0u, 1u, 2u, 0u, 2u, 3u})
+        m_indices.push_back(first + index);
+}
+
+void ChunkMesh::draw() const {
+    if (m_indexCount == 0)
+        return;
+    m_vertexArray.bind();
+    glDrawElements(GL_TRIANGLES, static_cast<GLsizei>(m_indexCount), GL_UNSIGNED_INT, nullptr);
+}
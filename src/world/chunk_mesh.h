@@ -0,0 +1,58 @@
+#pragma once
+
+#include <GL/glew.h>
+
+#include <vector>
+
+#include "buffer.h"
+#include "vertex_array.h"
+#include "chunk.h"
+
+// corner of a greedy meshed quad, matches the attributes of mesh.vert
+struct MeshVertex {
+    // chunk local corner x, y, z 7 bits each, then the index of the face direction in NEIGHBOR_OFFSETS
+    uint32_t packedPosition;
+    uint32_t material;
+};
+
+// The exposed faces of a chunk with coplanar neighbors of the same material merged into quads,
+// an alternative to drawing a billboard per voxel that suits large flat surfaces.
+class ChunkMesh {
+public:
+    ChunkMesh();
+
+    ChunkMesh(const ChunkMesh &other) = delete;
+
+    ChunkMesh &operator=(const ChunkMesh &other) = delete;
+
+    // meshes level 0 of the chunk, faces on its border look into the neighbors, and uploads it
+    void build(const Chunk &chunk);
+
+    void draw() const;
+
+    [[nodiscard]] size_t getVertexCount() const {
+        return m_vertexCount;
+    }
+
+    [[nodiscard]] size_t getIndexCount() const {
+        return m_indexCount;
+    }
+
+    [[nodiscard]] size_t getUploadSize() const {
+        return m_vertexCount * sizeof(MeshVertex) + m_indexCount * sizeof(GLuint);
+    }
+
+private:
+    Buffer m_vertexBuffer;
+    Buffer m_indexBuffer;
+    VertexArray m_vertexArray;
+    size_t m_vertexCount{0};
+    size_t m_indexCount{0};
+
+    // kept between builds to avoid reallocating
+    std::vector<MeshVertex> m_vertices;
+    std::vector<GLuint> m_indices;
+    std::vector<uint32_t> m_mask;
+
+    void addQuad(int direction, const glm::ivec3 &origin, const glm::ivec3 &du, const glm::ivec3 &dv, uint32_t material);
+};
@@ -0,0 +1,155 @@
+
+#include "chunk_storage.h"
+
+#include <algorithm>
+#include <cassert>
+
+ChunkStorage::ChunkStorage(size_t levels, size_t clustersPerLevel) : m_instanceBuffer(BufferUsage::DynamicDraw),
+                                                                    m_orderBuffer(BufferUsage::DynamicDraw),
+                                                                    m_commandBuffer(BufferUsage::DynamicDraw),
+                                                                    m_infoBuffer(BufferUsage::DynamicDraw),
+                                                                    m_clusterBuffer(BufferUsage::DynamicDraw),
+                                                                    m_levels(levels),
+                                                                    m_clustersPerLevel(clustersPerLevel) {
+    grow(INITIAL_CAPACITY);
+}
+
+GLuint ChunkStorage::allocate(GLuint count) {
+    for (;;) {
+        // first fit
+        for (auto it = m_freeRanges.begin(); it != m_freeRanges.end(); ++it) {
+            if (it->second < count)
+                continue;
+            GLuint first = it->first;
+            GLuint remaining = it->second - count;
+            m_freeRanges.erase(it);
+            if (remaining > 0)
+                m_freeRanges.emplace(first + count, remaining);
+            return first;
+        }
+        grow(std::max(m_capacity * 2, m_capacity + count));
+    }
+}
+
+void ChunkStorage::free(GLuint first, GLuint count) {
+    if (count == 0)
+        return;
+
+    auto next = m_freeRanges.lower_bound(first);
+    if (next != m_freeRanges.end() && first + count == next->first) {
+        count += next->second;
+        next = m_freeRanges.erase(next);
+    }
+    if (next != m_freeRanges.begin()) {
+        auto previous = std::prev(next);
+        if (previous->first + previous->second == first) {
+            previous->second += count;
+            return;
+        }
+    }
+    m_freeRanges.emplace(first, count);
+}
+
+void ChunkStorage::grow(GLuint capacity) {
+    GLuint previous = m_capacity;
+    m_instanceBuffer.grow(static_cast<GLsizeiptr>(capacity) * static_cast<GLsizeiptr>(sizeof(Voxel)));
+    m_orderBuffer.grow(static_cast<GLsizeiptr>(capacity) * static_cast<GLsizeiptr>(sizeof(InstanceOrder)));
+    m_capacity = capacity;
+    free(previous, capacity - previous);
+}
+
+void ChunkStorage::write(GLuint first, const std::vector<Voxel> &instances, const std::vector<InstanceOrder> &orders) {
+    assert(orders.size() == instances.size());
+    if (instances.empty())
+        return;
+    m_instanceBuffer.setSubData(static_cast<GLintptr>(first * sizeof(Voxel)), instances.data(),
+                                static_cast<GLsizeiptr>(instances.size() * sizeof(Voxel)));
+    m_orderBuffer.setSubData(static_cast<GLintptr>(first * sizeof(InstanceOrder)), orders.data(),
+                             static_cast<GLsizeiptr>(orders.size() * sizeof(InstanceOrder)));
+}
+
+void ChunkStorage::clearOrders(GLuint first, GLuint count) {
+    if (count == 0)
+        return;
+    glClearNamedBufferSubData(m_orderBuffer.getId(), GL_R32UI, static_cast<GLintptr>(first * sizeof(InstanceOrder)),
+                              static_cast<GLsizeiptr>(count * sizeof(InstanceOrder)), GL_RED_INTEGER, GL_UNSIGNED_INT,
+                              nullptr);
+}
+
+size_t ChunkStorage::addChunk() {
+    size_t index = m_infos.size();
+    m_infos.push_back(ChunkInfo());
+
+    DrawArraysIndirectCommand command{m_verticesPerInstance, 0, 0, 0};
+    auto size = static_cast<GLsizeiptr>(m_infos.size() * m_levels * sizeof(command));
+    if (size > m_commandBuffer.getCapacity())
+        m_commandBuffer.grow(std::max<GLsizeiptr>(size * 2, 64 * m_levels * sizeof(command)));
+    for (size_t level = 0; level < m_levels; ++level)
+        setCommand(index, static_cast<int>(level), command);
+
+    // grown buffers are uninitialized, the new clusters must read as empty before the first upload
+    auto clusterSize = static_cast<GLsizeiptr>(getClusterCount() * sizeof(ClusterInfo));
+    if (clusterSize > m_clusterBuffer.getCapacity())
+        m_clusterBuffer.grow(std::max<GLsizeiptr>(clusterSize * 2,
+                                                  64 * m_levels * m_clustersPerLevel * sizeof(ClusterInfo)));
+    setClusters(index, std::vector<ClusterInfo>(m_levels * m_clustersPerLevel));
+
+    // the info buffer is reallocated in flush
+    m_dirtyBegin = 0;
+    m_dirtyEnd = m_infos.size();
+    return index;
+}
+
+void ChunkStorage::setCommand(size_t index, int level, const DrawArraysIndirectCommand &command) {
+    m_commandBuffer.setSubData(static_cast<GLintptr>((index * m_levels + level) * sizeof(command)), &command,
+                               sizeof(command));
+}
+
+void ChunkStorage::setClusters(size_t index, const std::vector<ClusterInfo> &clusters) {
+    assert(clusters.size() == m_levels * m_clustersPerLevel);
+    m_clusterBuffer.setSubData(static_cast<GLintptr>(index * clusters.size() * sizeof(ClusterInfo)),
+                               clusters.data(), static_cast<GLsizeiptr>(clusters.size() * sizeof(ClusterInfo)));
+}
+
+void ChunkStorage::setVerticesPerInstance(GLuint count) {
+    if (count == m_verticesPerInstance)
+        return;
+    m_verticesPerInstance = count;
+    // only the count, instance counts may have been written by the compaction shader
+    for (size_t command = 0; command < m_infos.size() * m_levels; ++command)
+        m_commandBuffer.setSubData(static_cast<GLintptr>(command * sizeof(DrawArraysIndirectCommand)), &count,
+                                   sizeof(count));
+}
+
+void ChunkStorage::setInfo(size_t index, const ChunkInfo &info) {
+    m_infos[index] = info;
+    if (m_dirtyBegin == m_dirtyEnd) {
+        m_dirtyBegin = index;
+        m_dirtyEnd = index + 1;
+    } else {
+        m_dirtyBegin = std::min(m_dirtyBegin, index);
+        m_dirtyEnd = std::max(m_dirtyEnd, index + 1);
+    }
+}
+
+void ChunkStorage::flush() {
+    if (m_dirtyBegin == m_dirtyEnd)
+        return;
+
+    auto size = static_cast<GLsizeiptr>(m_infos.size() * sizeof(ChunkInfo));
+    if (m_infoBuffer.getSize() != size) {
+        m_infoBuffer.setData(m_infos);
+    } else {
+        m_infoBuffer.setSubData(static_cast<GLintptr>(m_dirtyBegin * sizeof(ChunkInfo)), &m_infos[m_dirtyBegin],
+                                static_cast<GLsizeiptr>((m_dirtyEnd - m_dirtyBegin) * sizeof(ChunkInfo)));
+    }
+    m_dirtyBegin = m_dirtyEnd = 0;
+}
+
+const Shader &ChunkStorage::getCompactionShader() {
+    if (!m_compactionShaderCompiled) {
+        m_compactionShader.init("shaders/compact.comp");
+        m_compactionShaderCompiled = true;
+    }
+    return m_compactionShader;
+}
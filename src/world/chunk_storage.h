@@ -0,0 +1,156 @@
+#pragma once
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+#include <map>
+#include <vector>
+
+#include "voxel.h"
+#include "buffer.h"
+#include "shader.h"
+#include "vertex_array.h"
+#include "draw_command.h"
+
+// per chunk data read by the culling and vertex shaders, matches ChunkInfo in the shaders
+struct ChunkInfo {
+    glm::vec4 boundsMin;
+    glm::vec4 boundsMax;
+    glm::vec4 position; // world space origin
+};
+
+// a fixed brick of a chunk whose instances are one contiguous range, the unit
+// of GPU culling, matches ClusterInfo in the shaders
+struct ClusterInfo {
+    glm::vec4 boundsMin{1.0f}; // world space, min > max for an empty cluster
+    glm::vec4 boundsMax{-1.0f};
+    GLuint chunk{0};
+    GLuint firstInstance{0};
+    GLuint instanceCount{0};
+    // bit i is set if some voxel has an exposed face towards NEIGHBOR_OFFSETS[i]
+    GLuint faceMask{0};
+};
+
+// the instances of a cluster can be walked front to back from every octant: there are INSTANCE_ORDERS
+// orders in which x ascends and y descends if bit 1 of the order is set and z if bit 0 is, each drawn
+// forwards or backwards. instances are stored in order 0 (ascending x, y, z), for the others every slot
+// of a cluster holds the signed 16 bit offset from the slot to the instance at that position of the
+// order, order 1 and 2 in the low and high half of x, order 3 in the low half of y
+constexpr int INSTANCE_ORDERS = 4;
+using InstanceOrder = glm::uvec2;
+
+// GPU side of all chunks of a world: the instances of every chunk live in one
+// buffer so they can all be drawn by a single multi draw call, next to one
+// indirect command per level of detail and one ChunkInfo per chunk index. Every
+// level of a chunk also owns clustersPerLevel consecutive ClusterInfo slots
+// starting at (index * levels + level) * clustersPerLevel.
+class ChunkStorage {
+public:
+    ChunkStorage(size_t levels, size_t clustersPerLevel);
+
+    ChunkStorage(const ChunkStorage &other) = delete;
+
+    ChunkStorage &operator=(const ChunkStorage &other) = delete;
+
+    // reserves room for count instances and returns the first one, grows the buffer if needed
+    GLuint allocate(GLuint count);
+
+    void free(GLuint first, GLuint count);
+
+    void write(GLuint first, const std::vector<Voxel> &instances, const std::vector<InstanceOrder> &orders);
+
+    // zeroes the orders of count instances, the compaction shader ors its offsets into them
+    void clearOrders(GLuint first, GLuint count);
+
+    // adds empty commands and clusters for every level and an info slot, returns the chunk index
+    size_t addChunk();
+
+    void setCommand(size_t index, int level, const DrawArraysIndirectCommand &command);
+
+    // 6 for the two triangles of a billboard, 1 for a point sprite, rewrites the count of every command
+    void setVerticesPerInstance(GLuint count);
+
+    [[nodiscard]] GLuint getVerticesPerInstance() const {
+        return m_verticesPerInstance;
+    }
+
+    void setInfo(size_t index, const ChunkInfo &info);
+
+    // replaces the clusters of all levels of the chunk at index
+    void setClusters(size_t index, const std::vector<ClusterInfo> &clusters);
+
+    // uploads the infos changed since the last call
+    void flush();
+
+    [[nodiscard]] size_t getChunkCount() const {
+        return m_infos.size();
+    }
+
+    // of all levels
+    [[nodiscard]] size_t getClusterCount() const {
+        return m_infos.size() * m_levels * m_clustersPerLevel;
+    }
+
+    [[nodiscard]] size_t getLevels() const {
+        return m_levels;
+    }
+
+    [[nodiscard]] size_t getClustersPerLevel() const {
+        return m_clustersPerLevel;
+    }
+
+    [[nodiscard]] const Buffer &getInstanceBuffer() const {
+        return m_instanceBuffer;
+    }
+
+    // one InstanceOrder per instance slot
+    [[nodiscard]] const Buffer &getOrderBuffer() const {
+        return m_orderBuffer;
+    }
+
+    [[nodiscard]] const Buffer &getCommandBuffer() const {
+        return m_commandBuffer;
+    }
+
+    [[nodiscard]] const Buffer &getInfoBuffer() const {
+        return m_infoBuffer;
+    }
+
+    [[nodiscard]] const Buffer &getClusterBuffer() const {
+        return m_clusterBuffer;
+    }
+
+    // has no attributes, the vertex shader reads the instance buffer by instance id and builds the
+    // billboard corners from the vertex id
+    [[nodiscard]] const VertexArray &getVertexArray() const {
+        return m_vertexArray;
+    }
+
+    // builds the instance lists of ChunkBuildMode::GpuCompaction, compiled on first use
+    const Shader &getCompactionShader();
+
+private:
+    Buffer m_instanceBuffer;
+    Buffer m_orderBuffer;
+    Buffer m_commandBuffer;
+    Buffer m_infoBuffer;
+    Buffer m_clusterBuffer;
+    VertexArray m_vertexArray;
+    Shader m_compactionShader;
+    bool m_compactionShaderCompiled{false};
+    GLuint m_verticesPerInstance{6};
+
+    size_t m_levels;
+    size_t m_clustersPerLevel;
+    GLuint m_capacity{0};
+    // first instance -> count of the unused ranges, adjacent ranges are always merged
+    std::map<GLuint, GLuint> m_freeRanges;
+
+    std::vector<ChunkInfo> m_infos;
+    size_t m_dirtyBegin{0};
+    size_t m_dirtyEnd{0};
+
+    static constexpr GLuint INITIAL_CAPACITY = 1 << 16;
+
+    void grow(GLuint capacity);
+};
@@ -0,0 +1,61 @@
+
+#include "upload_scheduler.h"
+
+#include <algorithm>
+#include <chrono>
+
+void UploadScheduler::enqueue(const glm::ivec3 &position, const std::shared_ptr<Chunk> &chunk) {
+    auto it = std::find_if(m_requests.begin(), m_requests.end(), [&](const Request &request) {
+        return request.chunk == chunk;
+    });
+    if (it == m_requests.end()) {
+        m_requests.push_back({position, chunk, {false, 0.0f}});
+    }
+}
+
+void UploadScheduler::process(const Camera &camera) {
+    m_stats = UploadStats();
+
+    for (auto &request: m_requests) {
+        request.priority = getPriority(request.position, camera);
+    }
+    std::sort(m_requests.begin(), m_requests.end(), [](const Request &a, const Request &b) {
+        return a.priority < b.priority;
+    });
+
+    auto start = std::chrono::steady_clock::now();
+    size_t uploaded = 0;
+    for (auto &request: m_requests) {
+        size_t size = request.chunk->getUploadSize();
+        double elapsed = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+        // always upload at least one chunk so a single large chunk can't stall the queue
+        if (uploaded > 0 && (m_stats.uploadedBytes + size > m_byteBudget || elapsed > m_timeBudget))
+            break;
+
+        request.chunk->upload();
+        m_stats.uploadedBytes += size;
+        ++uploaded;
+    }
+    m_stats.uploadedChunks = uploaded;
+    m_stats.uploadMilliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+    m_requests.erase(m_requests.begin(), m_requests.begin() + static_cast<std::ptrdiff_t>(uploaded));
+
+    m_stats.pendingChunks = m_requests.size();
+    for (auto &request: m_requests) {
+        m_stats.pendingBytes += request.chunk->getUploadSize();
+    }
+}
+
+UploadScheduler::Priority UploadScheduler::getPriority(const glm::ivec3 &position, const Camera &camera) {
+    constexpr float halfChunk = CHUNK_SIZE * 0.5f;
+    constexpr float chunkRadius = halfChunk * 1.73205080757f;
+
+    glm::vec3 toChunk = glm::vec3(position) * (float) CHUNK_SIZE + glm::vec3(halfChunk) - camera.getPosition();
+    float distance = glm::length(toChunk);
+
+    // chunks behind the camera go after every chunk in front of it, both nearest first
+    bool behind = glm::dot(toChunk, camera.getDirection()) <= -chunkRadius;
+    return {behind, distance};
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <vector>
+#include <memory>
+#include <utility>
+
+#include "chunk.h"
+#include "camera.h"
+
+struct UploadStats {
+    size_t uploadedChunks{0};
+    size_t uploadedBytes{0};
+    size_t pendingChunks{0};
+    size_t pendingBytes{0};
+    double uploadMilliseconds{0.0};
+};
+
+// Spreads chunk uploads over several frames. Chunks that don't fit into the
+// per-frame budget keep rendering their previously uploaded data.
+class UploadScheduler {
+public:
+    void setByteBudget(size_t bytes) {
+        m_byteBudget = bytes;
+    }
+
+    void setTimeBudget(double milliseconds) {
+        m_timeBudget = milliseconds;
+    }
+
+    void enqueue(const glm::ivec3 &position, const std::shared_ptr<Chunk> &chunk);
+
+    void process(const Camera &camera);
+
+    [[nodiscard]] const UploadStats &getStats() const {
+        return m_stats;
+    }
+
+private:
+    // whether the chunk is behind the camera, then its distance, lower goes first
+    using Priority = std::pair<bool, float>;
+
+    struct Request {
+        glm::ivec3 position;
+        std::shared_ptr<Chunk> chunk;
+        Priority priority;
+    };
+
+    std::vector<Request> m_requests;
+    UploadStats m_stats;
+
+    size_t m_byteBudget{8 * 1024 * 1024};
+    double m_timeBudget{2.0};
+
+    static Priority getPriority(const glm::ivec3 &position, const Camera &camera);
+};
@@ -0,0 +1,32 @@
+
+#include "voxel_volume.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+void VoxelVolume::setGrid(size_t slot, const std::vector<uint32_t> &grid) {
+    if (slot >= m_slots) {
+        // doubling keeps the copies of the whole storage rare while chunks are being added
+        m_slots = std::max(slot + 1, m_slots * 2);
+        m_grids.grow(static_cast<GLsizeiptr>(m_slots * GRID_WORDS * sizeof(uint32_t)));
+    }
+
+    m_packed.assign(GRID_WORDS, EMPTY_CELL | (EMPTY_CELL << 16));
+    for (size_t i = 0; i < grid.size(); ++i) {
+        uint32_t material = grid[i];
+        if (material == EMPTY_VOXEL)
+            continue;
+        if (material >= EMPTY_CELL)
+            throw std::runtime_error("Material id does not fit the voxel volume");
+        uint32_t shift = (i & 1) * 16;
+        m_packed[i / 2] = (m_packed[i / 2] & ~(0xFFFFu << shift)) | (material << shift);
+    }
+    m_grids.setSubData(static_cast<GLintptr>(slot * GRID_WORDS * sizeof(uint32_t)),
+                       m_packed.data(), static_cast<GLsizeiptr>(GRID_WORDS * sizeof(uint32_t)));
+}
+
+void VoxelVolume::setChunkMap(const glm::ivec3 &min, const glm::ivec3 &size, const std::vector<int32_t> &slots) {
+    m_min = min;
+    m_size = size;
+    m_chunkMap.setData(slots);
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <vector>
+
+#include "buffer.h"
+#include "chunk.h"
+
+// Material grids of every level of every chunk in one storage buffer and a map from chunk
+// position to grid slot, so that rays can be marched through the whole world on the GPU.
+// Cells are stored as 16 bit material ids, two per word, EMPTY_CELL where there is no voxel.
+class VoxelVolume {
+public:
+    static constexpr uint32_t EMPTY_CELL = 0xFFFF;
+    // words of one slot, every slot holds a whole Chunk grid
+    static constexpr size_t GRID_WORDS = (GRID_SIZE + 1) / 2;
+
+    // packs the grid of all levels into slot, the storage grows as needed
+    void setGrid(size_t slot, const std::vector<uint32_t> &grid);
+
+    // slots of the chunk positions in [min, min + size) ordered by x, y then z, -1 where there is no chunk
+    void setChunkMap(const glm::ivec3 &min, const glm::ivec3 &size, const std::vector<int32_t> &slots);
+
+    [[nodiscard]] const Buffer &getGridBuffer() const {
+        return m_grids;
+    }
+
+    [[nodiscard]] const Buffer &getChunkMapBuffer() const {
+        return m_chunkMap;
+    }
+
+    // bounds of the chunk map in chunks
+    [[nodiscard]] glm::ivec3 getMin() const {
+        return m_min;
+    }
+
+    [[nodiscard]] glm::ivec3 getSize() const {
+        return m_size;
+    }
+
+private:
+    Buffer m_grids{BufferUsage::DynamicDraw};
+    Buffer m_chunkMap{BufferUsage::DynamicDraw};
+    size_t m_slots{0};
+    glm::ivec3 m_min{0};
+    glm::ivec3 m_size{0};
+    std::vector<uint32_t> m_packed;
+};
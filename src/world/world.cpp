@@ -0,0 +1,613 @@
+
+#include "world.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+#include "draw_command.h"
+
+void World::addChunk(const glm::ivec3 &position, const std::shared_ptr<Chunk> &chunk) {
+    chunk->setBuildMode(m_buildMode);
+    chunk->attach(&m_chunkStorage, m_chunkStorage.addChunk(), glm::vec3(position) * (float) CHUNK_SIZE);
+    m_chunks.emplace(position, chunk);
+    m_dirtyChunks.insert(position);
+
+    if (m_chunkList.empty()) {
+        m_chunkMin = m_chunkMax = position;
+    } else {
+        m_chunkMin = glm::min(m_chunkMin, position);
+        m_chunkMax = glm::max(m_chunkMax, position);
+    }
+    m_chunkIndices.emplace(position, m_chunkList.size());
+    m_chunkList.push_back(chunk.get());
+    m_chunkPositions.push_back(position);
+    m_chunkBounds.add(glm::vec3(0.0f), glm::vec3(0.0f));
+    m_volumeDirtyChunks.push_back(1);
+    m_volumeDirty = true;
+    m_meshDirtyChunks.push_back(1);
+    m_meshesDirty = true;
+    m_reachabilityDirty = true;
+    m_anyMaterialValid = false;
+    updateBounds(m_chunkList.size() - 1);
+
+    // link the neighbors and re-evaluate the voxels on the shared faces
+    for (int direction = 0; direction < 6; ++direction) {
+        glm::ivec3 neighborPosition = position + NEIGHBOR_OFFSETS[direction];
+        auto neighbor = m_chunks.find(neighborPosition);
+        if (neighbor == m_chunks.end())
+            continue;
+
+        chunk->setNeighbor(direction, neighbor->second.get());
+        neighbor->second->setNeighbor(direction ^ 1, chunk.get());
+
+        chunk->updateBorderExposure(direction);
+        if (neighbor->second->updateBorderExposure(direction ^ 1))
+            m_dirtyChunks.insert(neighborPosition);
+    }
+}
+
+void World::flush(const Camera &camera) {
+    for (auto &position: m_dirtyChunks) {
+        auto chunk = m_chunks.find(position);
+        if (chunk != m_chunks.end()) {
+            std::array<uint8_t, 6> connections = chunk->second->getFaceConnections();
+            chunk->second->rebuild();
+            m_reachabilityDirty |= connections != chunk->second->getFaceConnections();
+            m_anyMaterialValid = false;
+            size_t index = m_chunkIndices[position];
+            updateBounds(index);
+            m_volumeDirtyChunks[index] = 1;
+            m_volumeDirty = true;
+            m_meshDirtyChunks[index] = 1;
+            m_meshesDirty = true;
+            m_uploadScheduler.enqueue(position, chunk->second);
+        }
+    }
+    m_dirtyChunks.clear();
+
+    m_uploadScheduler.process(camera);
+    m_chunkStorage.flush();
+}
+
+void World::setBuildMode(ChunkBuildMode mode) {
+    for (auto &chunk: m_chunks) {
+        if (chunk.second->getBuildMode() != mode) {
+            chunk.second->setBuildMode(mode);
+            m_dirtyChunks.insert(chunk.first);
+        }
+    }
+    m_buildMode = mode;
+}
+
+void World::cull(const Camera &camera, bool occlusion) {
+    m_chunkBounds.cull(camera.getFrustum(), m_chunkVisibility);
+    for (size_t i = 0; i < m_chunkList.size(); ++i)
+        m_chunkVisibility[i] &= m_chunkReachable[i];
+
+    m_clusterDrawsDirty = true;
+    m_renderStats = RenderStats();
+    m_renderStats.chunks = m_chunkList.size();
+    if (occlusion)
+        cullOccluded(camera);
+    for (size_t i = 0; i < m_chunkList.size(); ++i) {
+        if (m_chunkVisibility[i]) {
+            m_renderStats.instances += m_chunkList[i]->getInstanceCount();
+        } else {
+            ++m_renderStats.culledChunks;
+        }
+    }
+}
+
+void World::cullOccluded(const Camera &camera) {
+    glm::vec3 cameraPosition = camera.getPosition();
+    Frustum frustum = camera.getFrustum();
+    m_occlusionBuffer.clear(camera.getProjectionViewMatrix());
+
+    // the solid clusters of the nearest chunks hide the most, clusters surrounded by solid
+    // clusters of the same chunk are skipped since their neighbors cover them
+    for (uint32_t i: m_chunkOrder) {
+        if (!m_chunkVisibility[i])
+            continue;
+        uint64_t solid = m_chunkList[i]->getSolidClusters();
+        glm::vec3 origin = glm::vec3(m_chunkPositions[i]) * (float) CHUNK_SIZE;
+        for (int cluster = 0; cluster < CLUSTERS_PER_CHUNK && solid != 0; ++cluster) {
+            if (!((solid >> cluster) & 1u))
+                continue;
+            glm::ivec3 position(cluster / (CLUSTERS_PER_AXIS * CLUSTERS_PER_AXIS),
+                                (cluster / CLUSTERS_PER_AXIS) % CLUSTERS_PER_AXIS,
+                                cluster % CLUSTERS_PER_AXIS);
+            bool covered = true;
+            for (auto &offset: NEIGHBOR_OFFSETS) {
+                glm::ivec3 neighbor = position + offset;
+                if (glm::any(glm::lessThan(neighbor, glm::ivec3(0))) ||
+                    glm::any(glm::greaterThanEqual(neighbor, glm::ivec3(CLUSTERS_PER_AXIS))) ||
+                    !((solid >> ((neighbor.x * CLUSTERS_PER_AXIS + neighbor.y) * CLUSTERS_PER_AXIS + neighbor.z)) & 1u)) {
+                    covered = false;
+                    break;
+                }
+            }
+            glm::vec3 min = origin + glm::vec3(position * CLUSTER_SIZE);
+            glm::vec3 max = min + (float) CLUSTER_SIZE;
+            if (covered || !frustum.intersects(min, max))
+                continue;
+            m_occlusionBuffer.rasterizeBox(min - cameraPosition, max - cameraPosition);
+            if (++m_renderStats.occluders >= MAX_OCCLUDERS)
+                break;
+        }
+        if (m_renderStats.occluders >= MAX_OCCLUDERS)
+            break;
+    }
+
+    for (size_t i = 0; i < m_chunkList.size(); ++i) {
+        glm::vec3 boundsMin, boundsMax;
+        if (!m_chunkVisibility[i] || !getLevelBounds(i, boundsMin, boundsMax))
+            continue;
+        if (m_occlusionBuffer.isOccluded(boundsMin - cameraPosition, boundsMax - cameraPosition)) {
+            m_chunkVisibility[i] = 0;
+            ++m_renderStats.occludedChunks;
+        }
+    }
+}
+
+void World::updateChunkOrder(const Camera &camera, float focalLength) {
+    auto start = std::chrono::steady_clock::now();
+    uint64_t version = m_chunkOrderVersion;
+
+    if (refreshReachability(camera))
+        ++m_chunkOrderVersion;
+    sortChunks(camera);
+    selectLevels(focalLength);
+
+    ++m_chunkOrderStats.frames;
+    if (m_chunkOrderVersion != version)
+        ++m_chunkOrderStats.changes;
+    m_chunkOrderStats.milliseconds +=
+        std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+void World::updateReachability(const Camera &camera) {
+    auto start = std::chrono::steady_clock::now();
+    ++m_chunkOrderStats.frames;
+    if (refreshReachability(camera))
+        ++m_chunkOrderStats.changes;
+    m_chunkOrderStats.milliseconds +=
+        std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+bool World::refreshReachability(const Camera &camera) {
+    glm::ivec3 start = getChunkPosition(glm::ivec3(glm::floor(camera.getPosition())));
+    if (!m_reachabilityDirty && start == m_reachabilityStart)
+        return false;
+    m_reachabilityDirty = false;
+    m_reachabilityStart = start;
+
+    auto walkStart = std::chrono::steady_clock::now();
+    m_previousReachable.swap(m_chunkReachable);
+    findReachableChunks(start);
+    ++m_chunkOrderStats.walks;
+    m_chunkOrderStats.walkMilliseconds +=
+        std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - walkStart).count();
+    if (m_chunkReachable == m_previousReachable)
+        return false;
+    ++m_reachabilityVersion;
+    return true;
+}
+
+void World::findReachableChunks(const glm::ivec3 &start) {
+    m_chunkReachable.assign(m_chunkList.size(), 1);
+    m_unreachableChunks = 0;
+    if (!m_caveCulling || m_chunkList.empty())
+        return;
+
+    // missing chunks are empty, so the walk may leave the world as long as it stays in this box
+    glm::ivec3 min = glm::min(m_chunkMin, start) - 1;
+    glm::ivec3 max = glm::max(m_chunkMax, start) + 1;
+    glm::ivec3 size = max - min + 1;
+    size_t volume = static_cast<size_t>(size.x) * size.y * size.z;
+    if (volume > MAX_TRAVERSAL_CHUNKS)
+        return;
+
+    std::fill(m_chunkReachable.begin(), m_chunkReachable.end(), 0);
+    m_traversalVisited.assign(volume, 0);
+    auto visitedIndex = [&](const glm::ivec3 &position) {
+        glm::ivec3 local = position - min;
+        return (static_cast<size_t>(local.x) * size.y + local.y) * size.z + local.z;
+    };
+
+    struct Step {
+        glm::ivec3 position;
+        // face the walk entered through, -1 for the camera's chunk
+        int from;
+        // directions taken so far, the walk never turns back against one of them
+        uint8_t directions;
+    };
+
+    // the frustum is left to the culling, so that the walk holds for every direction of the camera
+    std::vector<Step> queue{{start, -1, 0}};
+    m_traversalVisited[visitedIndex(start)] = 1;
+    for (size_t head = 0; head < queue.size(); ++head) {
+        Step step = queue[head];
+        const Chunk *chunk = nullptr;
+        auto index = m_chunkIndices.find(step.position);
+        if (index != m_chunkIndices.end()) {
+            m_chunkReachable[index->second] = 1;
+            chunk = m_chunkList[index->second];
+        }
+
+        for (int direction = 0; direction < 6; ++direction) {
+            if (step.directions & (1u << (direction ^ 1)))
+                continue;
+            if (chunk && step.from >= 0 && !chunk->isConnected(step.from, direction))
+                continue;
+
+            glm::ivec3 next = step.position + NEIGHBOR_OFFSETS[direction];
+            if (glm::any(glm::lessThan(next, min)) || glm::any(glm::greaterThan(next, max)))
+                continue;
+            size_t visited = visitedIndex(next);
+            if (m_traversalVisited[visited])
+                continue;
+
+            m_traversalVisited[visited] = 1;
+            queue.push_back({next, direction ^ 1, static_cast<uint8_t>(step.directions | (1u << direction))});
+        }
+    }
+    m_unreachableChunks = static_cast<size_t>(std::count(m_chunkReachable.begin(), m_chunkReachable.end(), 0));
+}
+
+void World::sortChunks(const Camera &camera) {
+    glm::vec3 cameraPosition = camera.getPosition();
+    m_cameraPosition = cameraPosition;
+    m_chunkDistances.resize(m_chunkList.size());
+    for (size_t i = 0; i < m_chunkList.size(); ++i) {
+        glm::vec3 min = glm::vec3(m_chunkPositions[i]) * (float) CHUNK_SIZE;
+        glm::vec3 closest = glm::clamp(cameraPosition, min, min + (float) CHUNK_SIZE);
+        glm::vec3 offset = closest - cameraPosition;
+        m_chunkDistances[i] = glm::dot(offset, offset);
+    }
+
+    // the order barely changes between frames, which insertion sort handles in linear time
+    bool changed = false;
+    if (m_chunkOrder.size() != m_chunkList.size()) {
+        m_chunkOrder.resize(m_chunkList.size());
+        for (size_t i = 0; i < m_chunkOrder.size(); ++i)
+            m_chunkOrder[i] = static_cast<uint32_t>(i);
+        changed = true;
+    }
+    for (size_t i = 1; i < m_chunkOrder.size(); ++i) {
+        uint32_t index = m_chunkOrder[i];
+        size_t j = i;
+        for (; j > 0 && m_chunkDistances[m_chunkOrder[j - 1]] > m_chunkDistances[index]; --j)
+            m_chunkOrder[j] = m_chunkOrder[j - 1];
+        m_chunkOrder[j] = index;
+        changed |= j != i;
+    }
+    if (changed)
+        ++m_chunkOrderVersion;
+}
+
+void World::selectLevels(float focalLength) {
+    if (m_chunkLevels.size() != m_chunkList.size())
+        ++m_chunkOrderVersion;
+    m_chunkLevels.resize(m_chunkList.size(), 0);
+    for (size_t i = 0; i < m_chunkList.size(); ++i) {
+        // a cell of level l is 2^l * focalLength / distance pixels large
+        float distance = std::sqrt(m_chunkDistances[i]);
+        float level = m_lodPixels > 0.0f && distance > 0.0f ? std::log2(m_lodPixels * distance / focalLength) : 0.0f;
+
+        // the hysteresis keeps chunks near a threshold from switching back and forth
+        auto current = static_cast<float>(m_chunkLevels[i]);
+        if (level >= current + 1.0f + LOD_HYSTERESIS || level < current - LOD_HYSTERESIS) {
+            auto selected = static_cast<uint32_t>(glm::clamp(std::floor(level), 0.0f, (float) (LOD_LEVELS - 1)));
+            if (selected != m_chunkLevels[i]) {
+                m_chunkLevels[i] = selected;
+                ++m_chunkOrderVersion;
+                updateCullBounds(i);
+            }
+        }
+    }
+}
+
+void World::setChunkLevels(const std::vector<uint32_t> &levels) {
+    m_chunkLevels.resize(m_chunkList.size(), 0);
+    for (size_t i = 0; i < m_chunkList.size() && i < levels.size(); ++i) {
+        if (levels[i] != m_chunkLevels[i]) {
+            m_chunkLevels[i] = levels[i];
+            ++m_chunkOrderVersion;
+            updateCullBounds(i);
+        }
+    }
+}
+
+const VoxelVolume &World::updateVolume() {
+    if (!m_volumeDirty)
+        return m_volume;
+
+    for (size_t i = 0; i < m_chunkList.size(); ++i) {
+        if (m_volumeDirtyChunks[i])
+            m_volume.setGrid(i, m_chunkList[i]->getGrid());
+    }
+    std::fill(m_volumeDirtyChunks.begin(), m_volumeDirtyChunks.end(), 0);
+
+    // empty chunks are left out of the map so that rays skip them at once
+    glm::ivec3 size = m_chunkMax - m_chunkMin + 1;
+    std::vector<int32_t> slots(static_cast<size_t>(size.x) * size.y * size.z, -1);
+    for (size_t i = 0; i < m_chunkList.size(); ++i) {
+        if (m_chunkList[i]->getVoxelCount() == 0)
+            continue;
+        glm::ivec3 local = m_chunkPositions[i] - m_chunkMin;
+        slots[(static_cast<size_t>(local.x) * size.y + local.y) * size.z + local.z] = static_cast<int32_t>(i);
+    }
+    m_volume.setChunkMap(m_chunkMin, size, slots);
+    m_volumeDirty = false;
+    return m_volume;
+}
+
+void World::updateMeshes() {
+    if (!m_meshesDirty)
+        return;
+
+    auto start = std::chrono::steady_clock::now();
+    m_chunkMeshes.resize(m_chunkList.size());
+    for (size_t i = 0; i < m_chunkList.size(); ++i) {
+        if (!m_meshDirtyChunks[i])
+            continue;
+        if (!m_chunkMeshes[i])
+            m_chunkMeshes[i] = std::make_unique<ChunkMesh>();
+        m_chunkMeshes[i]->build(*m_chunkList[i]);
+        m_meshDirtyChunks[i] = 0;
+    }
+    m_meshesDirty = false;
+
+    double buildMilliseconds = m_meshStats.buildMilliseconds;
+    m_meshStats = MeshStats();
+    for (auto &mesh: m_chunkMeshes) {
+        m_meshStats.vertices += mesh->getVertexCount();
+        m_meshStats.indices += mesh->getIndexCount();
+        m_meshStats.uploadBytes += mesh->getUploadSize();
+    }
+    m_meshStats.buildMilliseconds = buildMilliseconds +
+        std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+void World::renderMeshes(const Shader &shader, const Shader &untextured, const std::vector<uint8_t> &texturedMaterials) {
+    const Shader *current = nullptr;
+    for (uint32_t i: m_chunkOrder) {
+        if (!m_chunkVisibility[i])
+            continue;
+        const Shader &chunkShader = m_chunkList[i]->hasAnyMaterial(texturedMaterials) ? shader : untextured;
+        if (&chunkShader != current) {
+            current = &chunkShader;
+            current->use();
+            current->setFloat("uChunkSize", CHUNK_SIZE);
+        }
+        current->setVec3("uChunkPosition", glm::vec3(m_chunkPositions[i]));
+        m_chunkMeshes[i]->draw();
+    }
+}
+
+void World::render(const Shader &shader, const Shader &untextured, const std::vector<uint8_t> &texturedMaterials) {
+    if (m_clusterDrawsDirty)
+        updateClusterDraws();
+    m_chunkStorage.getVertexArray().bind();
+
+    // the program only changes between neighbors in the sorted order that differ in their materials
+    const Shader *current = nullptr;
+    bool chunkIndices = false;
+    const Buffer *indirect = nullptr;
+    auto bindIndirect = [&](const Buffer &buffer) {
+        if (indirect != &buffer) {
+            indirect = &buffer;
+            glBindBuffer(GL_DRAW_INDIRECT_BUFFER, buffer.getId());
+        }
+    };
+    // the commands of a multi draw that is still being extended
+    GLuint runFirst = 0;
+    GLuint runCount = 0;
+    auto drawRun = [&]() {
+        if (runCount == 0)
+            return;
+        bindIndirect(m_clusterCommandBuffer);
+        current->setInt("uMultiDraw", 1);
+        current->setInt("uDrawOffset", static_cast<int>(runFirst));
+        auto offset = static_cast<GLintptr>(runFirst * sizeof(DrawArraysIndirectCommand));
+        glMultiDrawArraysIndirect(getInstancePrimitive(), reinterpret_cast<const void *>(offset),
+                                  static_cast<GLsizei>(runCount), 0);
+        runCount = 0;
+    };
+
+    for (uint32_t i: m_chunkOrder) {
+        if (!m_chunkVisibility[i])
+            continue;
+        const Shader &chunkShader = m_chunkList[i]->hasAnyMaterial(texturedMaterials) ? shader : untextured;
+        if (&chunkShader != current) {
+            drawRun();
+            current = &chunkShader;
+            current->use();
+            current->setFloat("uChunkSize", CHUNK_SIZE);
+            // only read by the visibility buffer
+            chunkIndices = current->hasUniform("uChunkIndex");
+            // binding points are shared with the compute shaders
+            current->setStorageBuffer("uChunks", m_chunkStorage.getInfoBuffer(), 1);
+            current->setStorageBuffer("uDrawChunks", m_clusterDrawChunkBuffer, 2);
+            current->setStorageBuffer("uInstances", m_chunkStorage.getInstanceBuffer(), 4);
+            current->setStorageBuffer("uInstanceOrders", m_chunkStorage.getOrderBuffer(), 5);
+        }
+
+        glm::uvec2 range = m_clusterDrawRanges[i];
+        if (range.y > 0) {
+            if (runCount > 0 && runFirst + runCount != range.x)
+                drawRun();
+            if (runCount == 0)
+                runFirst = range.x;
+            runCount += range.y;
+            continue;
+        }
+        if (!m_chunkList[i]->getUploadedClusters().empty() && GLEW_ARB_shader_draw_parameters)
+            continue;
+
+        // the clusters of a compacted chunk are only known on the GPU, the level is drawn as a whole
+        drawRun();
+        bindIndirect(m_chunkStorage.getCommandBuffer());
+        current->setInt("uMultiDraw", 0);
+        current->setVec3("uChunkPosition", glm::vec3(m_chunkPositions[i]));
+        if (chunkIndices)
+            current->setInt("uChunkIndex", static_cast<int>(m_chunkList[i]->getIndex()));
+        current->setFloat("uVoxelScale", static_cast<float>(1 << m_chunkLevels[i]));
+        current->setInt("uBaseInstance", static_cast<int>(m_chunkList[i]->getFirstInstance(m_chunkLevels[i])));
+        size_t command = m_chunkList[i]->getIndex() * LOD_LEVELS + m_chunkLevels[i];
+        auto offset = static_cast<GLintptr>(command * sizeof(DrawArraysIndirectCommand));
+        glDrawArraysIndirect(getInstancePrimitive(), reinterpret_cast<const void *>(offset));
+    }
+    drawRun();
+}
+
+void World::updateClusterDraws() {
+    m_clusterCommands.clear();
+    m_clusterDrawChunks.clear();
+    m_clusterDrawRanges.assign(m_chunkList.size(), glm::uvec2(0));
+    m_clusterDrawsDirty = false;
+    // the vertex shader can't tell the commands of a multi draw apart without the draw id
+    if (!GLEW_ARB_shader_draw_parameters)
+        return;
+
+    GLuint verticesPerInstance = m_chunkStorage.getVerticesPerInstance();
+    for (uint32_t i: m_chunkOrder) {
+        const std::vector<ClusterInfo> &clusters = m_chunkList[i]->getUploadedClusters();
+        if (!m_chunkVisibility[i] || clusters.empty())
+            continue;
+        const ClusterInfo *level = clusters.data() + m_chunkLevels[i] * CLUSTERS_PER_CHUNK;
+        auto first = static_cast<GLuint>(m_clusterCommands.size());
+
+        // walk the clusters away from the camera along every axis like cull.comp, so that they are front to back
+        glm::vec3 chunkCenter = glm::vec3(m_chunkPositions[i]) * (float) CHUNK_SIZE + glm::vec3(CHUNK_SIZE / 2);
+        glm::bvec3 flip = glm::greaterThan(m_cameraPosition, chunkCenter);
+        for (int local = 0; local < CLUSTERS_PER_CHUNK; ++local) {
+            glm::ivec3 coordinate(local / (CLUSTERS_PER_AXIS * CLUSTERS_PER_AXIS), (local / CLUSTERS_PER_AXIS) % CLUSTERS_PER_AXIS,
+                                  local % CLUSTERS_PER_AXIS);
+            for (int axis = 0; axis < 3; ++axis) {
+                if (flip[axis])
+                    coordinate[axis] = CLUSTERS_PER_AXIS - 1 - coordinate[axis];
+            }
+            const ClusterInfo &cluster = level[(coordinate.x * CLUSTERS_PER_AXIS + coordinate.y) * CLUSTERS_PER_AXIS + coordinate.z];
+            if (cluster.instanceCount == 0)
+                continue;
+
+            // the instance order of the camera's octant, walked backwards from the +x side so that
+            // the voxels of the cluster are front to back as well
+            glm::bvec3 ahead = glm::greaterThan(glm::vec3(cluster.boundsMin + cluster.boundsMax) * 0.5f, m_cameraPosition);
+            bool reversed = !ahead.x;
+            GLuint order = (ahead.y != reversed ? 0u : 2u) | (ahead.z != reversed ? 0u : 1u);
+            GLuint baseInstance = reversed ? cluster.firstInstance + cluster.instanceCount - 1 : cluster.firstInstance;
+            m_clusterCommands.push_back({verticesPerInstance, cluster.instanceCount, 0, baseInstance});
+            m_clusterDrawChunks.push_back(cluster.chunk | (m_chunkLevels[i] << DRAW_LEVEL_SHIFT) |
+                                          (order << DRAW_ORDER_SHIFT) | (reversed ? DRAW_REVERSED : 0u));
+        }
+        m_clusterDrawRanges[i] = {first, static_cast<GLuint>(m_clusterCommands.size()) - first};
+    }
+    m_clusterCommandBuffer.setData(m_clusterCommands);
+    m_clusterDrawChunkBuffer.setData(m_clusterDrawChunks);
+}
+
+bool World::hasAnyMaterial(const std::vector<uint8_t> &materials) const {
+    // asked for every frame, but the answer only changes with the chunks
+    if (m_anyMaterialValid && materials == m_anyMaterialKey)
+        return m_anyMaterial;
+    m_anyMaterial = std::any_of(m_chunkList.begin(), m_chunkList.end(), [&](const Chunk *chunk) {
+        return chunk->hasAnyMaterial(materials);
+    });
+    m_anyMaterialKey = materials;
+    m_anyMaterialValid = true;
+    return m_anyMaterial;
+}
+
+bool World::removeVoxel(const glm::ivec3 &position) {
+    glm::ivec3 chunkPosition = getChunkPosition(position);
+    auto chunk = m_chunks.find(chunkPosition);
+    if (chunk != m_chunks.end()) {
+        glm::ivec3 localPosition = getLocalPosition(position);
+        if (chunk->second->removeVoxel(localPosition)) {
+            m_dirtyChunks.insert(chunkPosition);
+            updateNeighborExposure(position);
+            return true;
+        }
+    }
+    return false;
+}
+
+void World::addVoxel(const glm::ivec3 &position, uint32_t material) {
+    glm::ivec3 chunkPosition = getChunkPosition(position);
+    glm::ivec3 localPosition = getLocalPosition(position);
+    auto chunk = m_chunks.find(chunkPosition);
+    if (chunk != m_chunks.end()) {
+        chunk->second->addVoxel(Voxel{localPosition, material});
+        m_dirtyChunks.insert(chunkPosition);
+    } else {
+        auto newChunk = std::make_shared<Chunk>();
+        newChunk->addVoxel(Voxel{localPosition, material});
+        addChunk(chunkPosition, newChunk);
+    }
+    updateNeighborExposure(position);
+}
+
+bool World::isVoxelEmpty(const glm::ivec3 &position) {
+    glm::ivec3 chunkPosition = getChunkPosition(position);
+    auto chunk = m_chunks.find(chunkPosition);
+    if (chunk != m_chunks.end()) {
+        glm::ivec3 localPosition = getLocalPosition(position);
+        return chunk->second->isVoxelEmpty(localPosition);
+    }
+    return true;
+}
+
+void World::updateNeighborExposure(const glm::ivec3 &position) {
+    glm::ivec3 chunkPosition = getChunkPosition(position);
+    for (auto &offset: NEIGHBOR_OFFSETS) {
+        glm::ivec3 neighborChunkPosition = getChunkPosition(position + offset);
+        if (neighborChunkPosition == chunkPosition)
+            continue;
+
+        auto chunk = m_chunks.find(neighborChunkPosition);
+        if (chunk != m_chunks.end() && chunk->second->updateExposure(getLocalPosition(position + offset)))
+            m_dirtyChunks.insert(neighborChunkPosition);
+    }
+}
+
+void World::updateBounds(size_t index) {
+    glm::vec3 origin = glm::vec3(m_chunkPositions[index]) * (float) CHUNK_SIZE;
+    ChunkInfo info;
+    info.position = glm::vec4(origin, 0.0f);
+
+    glm::ivec3 min, max;
+    if (m_chunkList[index]->getBounds(min, max)) {
+        info.boundsMin = glm::vec4(origin + glm::vec3(min), 0.0f);
+        info.boundsMax = glm::vec4(origin + glm::vec3(max) + 1.0f, 0.0f);
+    } else {
+        // inverted box, skipped by the culling shader
+        info.boundsMin = glm::vec4(1.0f);
+        info.boundsMax = glm::vec4(-1.0f);
+    }
+    m_chunkStorage.setInfo(m_chunkList[index]->getIndex(), info);
+    updateCullBounds(index);
+}
+
+bool World::getLevelBounds(size_t index, glm::vec3 &min, glm::vec3 &max) const {
+    glm::ivec3 cellMin, cellMax;
+    if (!m_chunkList[index]->getBounds(cellMin, cellMax))
+        return false;
+    // chunks added since the last selectLevels are drawn at level 0
+    int scale = index < m_chunkLevels.size() ? 1 << m_chunkLevels[index] : 1;
+    glm::vec3 origin = glm::vec3(m_chunkPositions[index]) * (float) CHUNK_SIZE;
+    min = origin + glm::vec3(cellMin / scale * scale);
+    max = origin + glm::vec3((cellMax / scale + 1) * scale);
+    return true;
+}
+
+void World::updateCullBounds(size_t index) {
+    glm::vec3 min, max;
+    if (getLevelBounds(index, min, max)) {
+        m_chunkBounds.set(index, min, max);
+    } else {
+        m_chunkBounds.setEmpty(index);
+    }
+}
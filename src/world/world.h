@@ -3,11 +3,20 @@
 #include <glm/glm.hpp>
 
 #include <unordered_map>
+#include <unordered_set>
 #include <memory>
+#include <vector>
 
 #include "voxel.h"
 #include "chunk.h"
+#include "chunk_storage.h"
 #include "shader.h"
+#include "camera.h"
+#include "frustum.h"
+#include "occlusion_buffer.h"
+#include "upload_scheduler.h"
+#include "voxel_volume.h"
+#include "chunk_mesh.h"
 
 namespace std {
     template<>
@@ -20,54 +29,183 @@ namespace std {
     };
 }
 
+struct RenderStats {
+    size_t chunks{0};
+    size_t culledChunks{0};
+    size_t instances{0};
+    // chunks culled by the software occlusion buffer and boxes drawn into it
+    size_t occludedChunks{0};
+    size_t occluders{0};
+};
+
+// what ordering the chunks costs on the CPU: the sort and level selection of World::updateChunkOrder
+// visit every chunk every frame, the cave culling walk only runs when it would turn out differently
+struct ChunkOrderStats {
+    size_t frames{0};
+    // summed over all frames
+    double milliseconds{0.0};
+    // frames in which the order, a level or a reachable chunk changed
+    size_t changes{0};
+    // frames in which the cave culling walk ran and what it took, part of milliseconds
+    size_t walks{0};
+    double walkMilliseconds{0.0};
+};
+
+struct MeshStats {
+    size_t vertices{0};
+    size_t indices{0};
+    size_t uploadBytes{0};
+    // spent meshing and uploading since the world was created
+    double buildMilliseconds{0.0};
+};
+
 class World {
 public:
-    void addChunk(const glm::ivec3 &position, const std::shared_ptr<Chunk> &chunk) {
-        m_chunks.emplace(position, chunk);
-        chunk->upload();
+    void addChunk(const glm::ivec3 &position, const std::shared_ptr<Chunk> &chunk);
+
+    // rebuilds every chunk edited since the last flush exactly once and uploads
+    // them within the scheduler's budget, must be called before render
+    void flush(const Camera &camera);
+
+    void setBuildMode(ChunkBuildMode mode);
+
+    // updates the reachable chunks, then sortChunks and selectLevels with the camera of this frame,
+    // timed in getChunkOrderStats. this is O(chunks) on the CPU every frame, the GPU culling modes
+    // only call updateReachability and order the chunks in order.comp
+    void updateChunkOrder(const Camera &camera, float focalLength);
+
+    // walks from the camera's chunk through the faces that are connected by empty space, chunks that
+    // can't be reached are hidden behind solid voxels. the walk only runs again once the camera
+    // enters another chunk or a chunk is added or changes its connectivity, timed in
+    // getChunkOrderStats. must be called before cull and the GPU culler
+    void updateReachability(const Camera &camera);
+
+    // changes whenever a chunk becomes reachable or unreachable, so that the GPU copy is only
+    // uploaded then
+    [[nodiscard]] uint64_t getReachabilityVersion() const {
+        return m_reachabilityVersion;
     }
 
+    [[nodiscard]] const ChunkOrderStats &getChunkOrderStats() const {
+        return m_chunkOrderStats;
+    }
+
+    void setCaveCulling(bool enabled) {
+        m_reachabilityDirty |= m_caveCulling != enabled;
+        m_caveCulling = enabled;
+    }
+
+    [[nodiscard]] bool isChunkReachable(size_t index) const {
+        return m_chunkReachable[index] != 0;
+    }
+
+    [[nodiscard]] size_t getUnreachableChunkCount() const {
+        return m_unreachableChunks;
+    }
+
+    // frustum culls the chunks on the CPU and drops the unreachable ones, with occlusion also those
+    // hidden behind solid clusters of nearer chunks. uses the order and levels of the last
+    // sortChunks and selectLevels, must be called before render
+    void cull(const Camera &camera, bool occlusion = false);
+
+    // sorts the chunks front to back by the distance of their cube to the camera, so that
+    // the depth test rejects as much as possible, must be called before render
+    void sortChunks(const Camera &camera);
+
+    // picks the level of detail of every chunk from the size of its voxels on screen, uses the
+    // distances of the last sortChunks, focalLength is the projection's scale in pixels
+    void selectLevels(float focalLength);
+
+    // the coarsest level whose cells still project to at most this many pixels is used, 0 disables it
+    void setLodPixels(float pixels) {
+        m_lodPixels = pixels;
+    }
+
+    [[nodiscard]] float getLodPixels() const {
+        return m_lodPixels;
+    }
+
+    // draws the chunks that passed cull in the sorted order, those without any of the materials set
+    // in texturedMaterials with untextured, which may be the same program. the clusters of chunks
+    // built on the CPU are drawn by multi draws in the order of the camera's octant as of the last
+    // sortChunks, compacted chunks one level at a time
+    void render(const Shader &shader, const Shader &untextured, const std::vector<uint8_t> &texturedMaterials);
+
     void render(const Shader &shader) {
-        shader.setFloat("uChunkSize", CHUNK_SIZE);
-        for (auto &chunk: m_chunks) {
-            shader.setVec3("uChunkPosition", glm::vec3(chunk.first));
-            chunk.second->render();
-        }
+        render(shader, shader, {});
     }
 
-    bool removeVoxel(const glm::ivec3 &position) {
-        glm::ivec3 chunkPosition = getChunkPosition(position);
-        auto chunk = m_chunks.find(chunkPosition);
-        if (chunk != m_chunks.end()) {
-            glm::ivec3 localPosition = getLocalPosition(position);
-            return chunk->second->removeVoxel(localPosition);
-        }
-        return false;
-    }
-
-    void addVoxel(const glm::ivec3 &position, uint32_t material) {
-        glm::ivec3 chunkPosition = getChunkPosition(position);
-        glm::ivec3 localPosition = getLocalPosition(position);
-        auto chunk = m_chunks.find(chunkPosition);
-        if (chunk != m_chunks.end()) {
-            chunk->second->addVoxel(Voxel{localPosition, material});
-        } else {
-            auto newChunk = std::make_shared<Chunk>();
-            newChunk->addVoxel(Voxel{localPosition, material});
-            addChunk(chunkPosition, newChunk);
-        }
+    // whether some chunk has a voxel of one of the materials set in materials
+    [[nodiscard]] bool hasAnyMaterial(const std::vector<uint8_t> &materials) const;
+
+    // draws every instance as one point instead of the two triangles of a billboard
+    void setPointSprites(bool enabled) {
+        m_chunkStorage.setVerticesPerInstance(enabled ? 1 : 6);
     }
 
-    bool isVoxelEmpty(const glm::ivec3 &position) {
-        glm::ivec3 chunkPosition = getChunkPosition(position);
-        auto chunk = m_chunks.find(chunkPosition);
-        if (chunk != m_chunks.end()) {
-            glm::ivec3 localPosition = getLocalPosition(position);
-            return chunk->second->isVoxelEmpty(localPosition);
-        }
-        return true;
+    [[nodiscard]] GLenum getInstancePrimitive() const {
+        return m_chunkStorage.getVerticesPerInstance() == 1 ? GL_POINTS : GL_TRIANGLES;
+    }
+
+    [[nodiscard]] size_t getChunkCount() const {
+        return m_chunkList.size();
+    }
+
+    [[nodiscard]] const Chunk &getChunk(size_t index) const {
+        return *m_chunkList[index];
+    }
+
+    // chunk position of every chunk index
+    [[nodiscard]] const std::vector<glm::ivec3> &getChunkPositions() const {
+        return m_chunkPositions;
+    }
+
+    // every chunk position is within [getChunkMin(), getChunkMax()]
+    [[nodiscard]] glm::ivec3 getChunkMin() const {
+        return m_chunkMin;
+    }
+
+    [[nodiscard]] glm::ivec3 getChunkMax() const {
+        return m_chunkMax;
     }
 
+    // chunk indices in front to back order as of the last sortChunks
+    [[nodiscard]] const std::vector<uint32_t> &getChunkOrder() const {
+        return m_chunkOrder;
+    }
+
+    // level of detail of every chunk as of the last selectLevels or setChunkLevels
+    [[nodiscard]] const std::vector<uint32_t> &getChunkLevels() const {
+        return m_chunkLevels;
+    }
+
+    // levels selected elsewhere, e.g. by order.comp, for the reference tracer and the CPU culling
+    void setChunkLevels(const std::vector<uint32_t> &levels);
+
+    // uploads the grids of the chunks rebuilt since the last call for ray marching, must be called after flush
+    const VoxelVolume &updateVolume();
+
+    // greedy meshes the chunks rebuilt since the last call, must be called after flush
+    void updateMeshes();
+
+    // draws the meshes of the chunks that passed cull in the sorted order, picks the program like render
+    void renderMeshes(const Shader &shader, const Shader &untextured, const std::vector<uint8_t> &texturedMaterials);
+
+    [[nodiscard]] const MeshStats &getMeshStats() const {
+        return m_meshStats;
+    }
+
+    // instances, draw commands, bounds and clusters of every chunk for GPU driven rendering
+    [[nodiscard]] const ChunkStorage &getChunkStorage() const {
+        return m_chunkStorage;
+    }
+
+    bool removeVoxel(const glm::ivec3 &position);
+
+    void addVoxel(const glm::ivec3 &position, uint32_t material);
+
+    bool isVoxelEmpty(const glm::ivec3 &position);
+
     size_t getVoxelCount() {
         size_t count = 0;
         for (auto &chunk: m_chunks) {
@@ -76,8 +214,122 @@ public:
         return count;
     }
 
+    size_t getInstanceCount() {
+        size_t count = 0;
+        for (auto &chunk: m_chunks) {
+            count += chunk.second->getInstanceCount();
+        }
+        return count;
+    }
+
+    UploadScheduler &getUploadScheduler() {
+        return m_uploadScheduler;
+    }
+
+    [[nodiscard]] const RenderStats &getRenderStats() const {
+        return m_renderStats;
+    }
+
 private:
+    // declared first so that it outlives the chunks that release their ranges in it
+    ChunkStorage m_chunkStorage{LOD_LEVELS, CLUSTERS_PER_CHUNK};
     std::unordered_map<glm::ivec3, std::shared_ptr<Chunk>> m_chunks;
+    std::unordered_set<glm::ivec3> m_dirtyChunks;
+    UploadScheduler m_uploadScheduler;
+    ChunkBuildMode m_buildMode{ChunkBuildMode::Cpu};
+
+    // chunks in the order they were added, indices match m_chunkBounds and m_chunkStorage
+    std::unordered_map<glm::ivec3, size_t> m_chunkIndices;
+    std::vector<Chunk *> m_chunkList;
+    std::vector<glm::ivec3> m_chunkPositions;
+    BoundingBoxes m_chunkBounds;
+    std::vector<uint8_t> m_chunkVisibility;
+    std::vector<uint32_t> m_chunkOrder;
+    std::vector<float> m_chunkDistances;
+    glm::vec3 m_cameraPosition{0.0f};
+    std::vector<uint32_t> m_chunkLevels;
+    float m_lodPixels{2.0f};
+
+    uint64_t m_chunkOrderVersion{0};
+    ChunkOrderStats m_chunkOrderStats;
+
+    bool m_caveCulling{true};
+    std::vector<uint8_t> m_chunkReachable;
+    // of the walk before, to tell whether it changed anything
+    std::vector<uint8_t> m_previousReachable;
+    size_t m_unreachableChunks{0};
+    uint64_t m_reachabilityVersion{0};
+    // the chunk the last walk started in, it is redone if the camera leaves it or this is set
+    glm::ivec3 m_reachabilityStart{0};
+    bool m_reachabilityDirty{true};
+    // chunk positions of the world are within [m_chunkMin, m_chunkMax]
+    glm::ivec3 m_chunkMin{0};
+    glm::ivec3 m_chunkMax{0};
+    std::vector<uint8_t> m_traversalVisited;
+
+    // the walk covers the box around the chunks and the camera, beyond this many chunks it is skipped
+    static constexpr size_t MAX_TRAVERSAL_CHUNKS = 1 << 20;
+
+    // a chunk only changes its level once it is this far past the threshold, in levels
+    static constexpr float LOD_HYSTERESIS = 0.2f;
+
+    // a fifth of the window in each direction is plenty for whole chunks
+    OcclusionBuffer m_occlusionBuffer{320, 180};
+    // the nearest occluders hide the most, beyond this many rasterizing costs more than it saves
+    static constexpr size_t MAX_OCCLUDERS = 2048;
+    RenderStats m_renderStats;
+
+    // built by render after every cull, chunks that follow each other in the sorted order and use the
+    // same program are drawn by one multi draw over their clusters
+    std::vector<DrawArraysIndirectCommand> m_clusterCommands;
+    // the chunk entry of every command, see DRAW_CHUNK_MASK
+    std::vector<GLuint> m_clusterDrawChunks;
+    // first command and number of commands of every chunk
+    std::vector<glm::uvec2> m_clusterDrawRanges;
+    Buffer m_clusterCommandBuffer{BufferUsage::StreamDraw};
+    Buffer m_clusterDrawChunkBuffer{BufferUsage::StreamDraw};
+    bool m_clusterDrawsDirty{true};
+
+    // only kept up to date while something ray marches it
+    VoxelVolume m_volume;
+    std::vector<uint8_t> m_volumeDirtyChunks;
+    bool m_volumeDirty{true};
+
+    // like the volume only built while meshes are drawn
+    std::vector<std::unique_ptr<ChunkMesh>> m_chunkMeshes;
+    std::vector<uint8_t> m_meshDirtyChunks;
+    bool m_meshesDirty{true};
+    MeshStats m_meshStats;
+
+    // hasAnyMaterial of the last materials asked for, until a chunk is added or rebuilt
+    mutable std::vector<uint8_t> m_anyMaterialKey;
+    mutable bool m_anyMaterial{false};
+    mutable bool m_anyMaterialValid{false};
+
+    // rasterizes the exposed solid clusters front to back and hides the visible chunks behind them
+    void cullOccluded(const Camera &camera);
+
+    // walks again if needed, true if it changed the reachable chunks
+    bool refreshReachability(const Camera &camera);
+
+    // the walk of updateReachability from the chunk at start
+    void findReachableChunks(const glm::ivec3 &start);
+
+    // the chunk updates neighbors of an edited voxel itself, except for those in other chunks
+    void updateNeighborExposure(const glm::ivec3 &position);
+
+    void updateBounds(size_t index);
+
+    // one command per non empty cluster of the selected level of every visible chunk built on the CPU,
+    // in the sorted order and the clusters of each chunk in the order of the camera's octant
+    void updateClusterDraws();
+
+    // bounds of the chunk's cells at its selected level, coarse cells may reach past the tight bounds
+    // of level 0 up to their own grid. false if the chunk is empty
+    bool getLevelBounds(size_t index, glm::vec3 &min, glm::vec3 &max) const;
+
+    // the frustum test uses the bounds of the selected level
+    void updateCullBounds(size_t index);
 
     static int mod(int k, int n) {
         return ((k %= n) < 0) ? k + n : k;
@@ -0,0 +1,72 @@
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <vector>
+
+#include "camera.h"
+#include "occlusion_buffer.h"
+
+// a terrain frame's worth of occluders and of chunks and clusters tested against them
+static constexpr int OCCLUDERS = 256;
+static constexpr int QUERIES = 1024;
+
+struct Box {
+    glm::vec3 min;
+    glm::vec3 max;
+};
+
+// cluster sized boxes spread over the view like the terrain, in front of the camera at the origin
+static std::vector<Box> createBoxes(std::mt19937 &random, int count, float nearest, float farthest) {
+    std::uniform_real_distribution<float> depth(nearest, farthest);
+    std::uniform_real_distribution<float> side(-0.5f, 0.5f);
+    std::vector<Box> boxes;
+    for (int i = 0; i < count; ++i) {
+        float z = depth(random);
+        glm::vec3 min(side(random) * z, side(random) * z * 0.5f, z);
+        boxes.push_back({min, min + 16.0f});
+    }
+    return boxes;
+}
+
+// rasterizes the occluders and tests the queries of a terrain like frame, prints the time of both
+// per frame. usage: occlusion_buffer_benchmark [frames]
+int main(int argc, char **argv) {
+    int frames = argc > 1 ? std::max(1, std::atoi(argv[1])) : 200;
+
+    Camera camera;
+    camera.setPerspective(glm::radians(60.0f), 16.0f / 9.0f, 0.1f, 1000.0f);
+    OcclusionBuffer buffer(320, 180);
+
+    std::mt19937 random(1);
+    std::vector<Box> occluders = createBoxes(random, OCCLUDERS, 8.0f, 64.0f);
+    std::vector<Box> queries = createBoxes(random, QUERIES, 32.0f, 256.0f);
+
+    using Clock = std::chrono::steady_clock;
+    double rasterizeMilliseconds = 0.0;
+    double queryMilliseconds = 0.0;
+    size_t occluded = 0;
+    for (int frame = 0; frame < frames; ++frame) {
+        auto start = Clock::now();
+        buffer.clear(camera.getProjectionViewMatrix());
+        for (auto &box: occluders)
+            buffer.rasterizeBox(box.min, box.max);
+        auto rasterized = Clock::now();
+        for (auto &box: queries)
+            occluded += buffer.isOccluded(box.min, box.max);
+        auto end = Clock::now();
+
+        rasterizeMilliseconds += std::chrono::duration<double, std::milli>(rasterized - start).count();
+        queryMilliseconds += std::chrono::duration<double, std::milli>(end - rasterized).count();
+    }
+
+    std::cout << "frames: " << frames
+              << " rasterize " << OCCLUDERS << " boxes: " << rasterizeMilliseconds / frames << " ms"
+              << " test " << QUERIES << " boxes: " << queryMilliseconds / frames << " ms"
+              << " occluded: " << occluded / frames << "/" << QUERIES << std::endl;
+    return 0;
+}
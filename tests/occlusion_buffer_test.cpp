@@ -0,0 +1,89 @@
+
+#include <glm/glm.hpp>
+
+#include <iostream>
+
+#include "camera.h"
+#include "occlusion_buffer.h"
+
+// the size World uses, boxes are relative to a camera at the origin looking along +z
+static constexpr int WIDTH = 320;
+static constexpr int HEIGHT = 180;
+
+static int failures = 0;
+
+static void check(bool condition, const char *name) {
+    if (!condition) {
+        std::cerr << "FAILED: " << name << "\n";
+        ++failures;
+    }
+}
+
+static OcclusionBuffer createBuffer() {
+    Camera camera;
+    camera.setPerspective(glm::radians(60.0f), (float) WIDTH / (float) HEIGHT, 0.1f, 1000.0f);
+    OcclusionBuffer buffer(WIDTH, HEIGHT);
+    buffer.clear(camera.getProjectionViewMatrix());
+    return buffer;
+}
+
+static void testEmpty() {
+    OcclusionBuffer buffer = createBuffer();
+    check(!buffer.isOccluded({-1.0f, -1.0f, 20.0f}, {1.0f, 1.0f, 22.0f}), "nothing occludes an empty buffer");
+}
+
+static void testWall() {
+    OcclusionBuffer buffer = createBuffer();
+    // wider than the view, only its -z face points towards the camera
+    buffer.rasterizeBox({-100.0f, -100.0f, 10.0f}, {100.0f, 100.0f, 11.0f});
+
+    check(buffer.isOccluded({-1.0f, -1.0f, 20.0f}, {1.0f, 1.0f, 22.0f}), "box behind a wall");
+    check(buffer.isOccluded({-200.0f, -200.0f, 50.0f}, {200.0f, 200.0f, 60.0f}), "box larger than the view behind a wall");
+    check(!buffer.isOccluded({-1.0f, -1.0f, 5.0f}, {1.0f, 1.0f, 6.0f}), "box in front of a wall");
+    check(!buffer.isOccluded({-1.0f, -1.0f, 9.0f}, {1.0f, 1.0f, 12.0f}), "box reaching through a wall");
+    check(!buffer.isOccluded({-1.0f, -1.0f, -6.0f}, {1.0f, 1.0f, -5.0f}), "box behind the camera");
+}
+
+static void testPartialCover() {
+    OcclusionBuffer buffer = createBuffer();
+    // covers tan(x / z) up to 0.5 to both sides
+    buffer.rasterizeBox({-5.0f, -5.0f, 10.0f}, {5.0f, 5.0f, 11.0f});
+
+    check(buffer.isOccluded({2.0f, -1.0f, 20.0f}, {6.0f, 1.0f, 22.0f}), "box behind the middle of an occluder");
+    check(!buffer.isOccluded({8.0f, -1.0f, 20.0f}, {12.0f, 1.0f, 22.0f}), "box peeking out from behind an occluder");
+    check(!buffer.isOccluded({30.0f, -1.0f, 20.0f}, {34.0f, 1.0f, 22.0f}), "box beside an occluder");
+}
+
+static void testJoinedOccluders() {
+    OcclusionBuffer buffer = createBuffer();
+    // two halves of a wall that meet at x = 0, no pixel center may fall between them
+    buffer.rasterizeBox({-100.0f, -100.0f, 10.0f}, {0.0f, 100.0f, 11.0f});
+    buffer.rasterizeBox({0.0f, -100.0f, 12.0f}, {100.0f, 100.0f, 13.0f});
+
+    check(buffer.isOccluded({-2.0f, -2.0f, 30.0f}, {2.0f, 2.0f, 32.0f}), "box behind the seam of two occluders");
+    check(!buffer.isOccluded({0.5f, -1.0f, 11.5f}, {2.0f, 1.0f, 11.8f}), "box between the depths of two occluders");
+}
+
+static void testNearPlane() {
+    OcclusionBuffer buffer = createBuffer();
+    // the camera is inside, its projection is undefined so it is skipped
+    buffer.rasterizeBox({-1.0f, -1.0f, -1.0f}, {1.0f, 1.0f, 1.0f});
+
+    check(!buffer.isOccluded({-1.0f, -1.0f, 20.0f}, {1.0f, 1.0f, 22.0f}), "boxes crossing the near plane don't occlude");
+    check(!buffer.isOccluded({-1.0f, -1.0f, -1.0f}, {1.0f, 1.0f, 1.0f}), "boxes crossing the near plane aren't occluded");
+}
+
+int main() {
+    testEmpty();
+    testWall();
+    testPartialCover();
+    testJoinedOccluders();
+    testNearPlane();
+
+    if (failures > 0) {
+        std::cerr << failures << " checks failed\n";
+        return 1;
+    }
+    std::cout << "all checks passed\n";
+    return 0;
+}